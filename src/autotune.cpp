@@ -0,0 +1,187 @@
+#include "autotune.h"
+#include "factorize.h"
+#include "parameters.h"
+#include "smoothness_bound.h"
+#include "factors.h"
+#include "config.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <initializer_list>
+#include <map>
+
+using namespace std;
+
+vector<mpz_class> generate_semiprimes(unsigned int digits, unsigned int count, unsigned long seed)
+{
+    gmp_randclass rng(gmp_randinit_default);
+    rng.seed(seed);
+
+    // The first prime gets half of the digits, the second the rest
+    unsigned int digits1 = digits / 2;
+    unsigned int digits2 = digits - digits1;
+    mpz_class low1, low2;
+    mpz_ui_pow_ui(low1.get_mpz_t(), 10, digits1 - 1);
+    mpz_ui_pow_ui(low2.get_mpz_t(), 10, digits2 - 1);
+
+    vector<mpz_class> numbers;
+    while (numbers.size() < count)
+    {
+        mpz_class p = low1 + rng.get_z_range(9 * low1);
+        mpz_class q = low2 + rng.get_z_range(9 * low2);
+        mpz_nextprime(p.get_mpz_t(), p.get_mpz_t());
+        mpz_nextprime(q.get_mpz_t(), q.get_mpz_t());
+
+        mpz_class n = p * q;
+        if (p != q && n.get_str().size() == digits)
+            numbers.push_back(n);
+    }
+    return numbers;
+}
+
+// Total seconds taken to factor the numbers with the given parameters, or HUGE_VAL if one of them failed
+// or the total went past limit seconds
+static double time_parameters(const vector<mpz_class> &numbers, const TunedParameters &params, double limit)
+{
+    auto start = chrono::high_resolution_clock::now();
+    atomic<bool> cancel(false);
+
+    Options options;
+    options.verbose = false;
+    options.checkpoints = false;
+    options.parameter_file = "";
+    options.smoothness_bound = params.smoothness_bound;
+    options.sieve_interval = params.sieve_interval;
+    options.threshold_slack = params.threshold_slack;
+    options.extra_relations = params.extra_relations;
+    options.cancel = &cancel;
+
+    // Give up on parameters that are clearly slower than the best so far
+    options.progress = [&start, &cancel, limit](const Progress &) {
+        chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+        if (elapsed.count() > limit)
+            cancel = true;
+    };
+
+    for (const mpz_class &n : numbers)
+    {
+        Factorization factors;
+        string error;
+        if (!factorize(n, factors, options, error))
+            return HUGE_VAL;
+    }
+
+    chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+    return elapsed.count() > limit ? HUGE_VAL : elapsed.count();
+}
+
+static void print_parameters(const TunedParameters &params, double seconds)
+{
+    cout << "Autotune: " << params.digits << " digits, B = " << params.smoothness_bound
+         << ", sieve interval = " << params.sieve_interval << ", slack = " << params.threshold_slack
+         << ", extra relations = " << params.extra_relations << ": ";
+    if (seconds == HUGE_VAL)
+        cout << "failed or too slow" << endl;
+    else
+        cout << fixed << setprecision(3) << seconds << defaultfloat << " s" << endl;
+}
+
+// Times the candidate, giving up once it is clearly slower, and makes it the best if it is faster
+static void try_parameters(const vector<mpz_class> &numbers,
+                           const TunedParameters &candidate,
+                           TunedParameters &best,
+                           double &best_time)
+{
+    double seconds = time_parameters(numbers, candidate, 2 * best_time + 1);
+    print_parameters(candidate, seconds);
+    if (seconds < best_time)
+    {
+        best = candidate;
+        best_time = seconds;
+    }
+}
+
+// Coordinate search around the config.h defaults for one size of number
+static TunedParameters tune_size(unsigned int digits, const vector<mpz_class> &numbers)
+{
+    bool use_siqs = USE_SIQS && digits >= SIQS_MIN_DIGITS;
+    unsigned long multiplier = USE_MULTIPLIER ? knuth_schroeppel(numbers[0]) : 1;
+
+    TunedParameters best;
+    best.digits = digits;
+    best.smoothness_bound = smoothnessBound(numbers[0] * multiplier, use_siqs);
+    best.sieve_interval = use_siqs ? SIQS_SIEVE_INTERVAL : SIEVE_INTERVAL;
+    best.threshold_slack = SIEVE_THRESHOLD_SLACK;
+    best.extra_relations = SIQS_EXTRA_RELATIONS;
+
+    double best_time = time_parameters(numbers, best, HUGE_VAL);
+    print_parameters(best, best_time);
+
+    // Each sweep starts from the best parameters so far and keeps the fastest value it tries
+    TunedParameters base = best;
+    for (double scale : {0.5, 0.7, 1.4, 2.0})
+    {
+        TunedParameters candidate = base;
+        candidate.smoothness_bound = max(static_cast<unsigned long>(base.smoothness_bound * scale), 100UL);
+        try_parameters(numbers, candidate, best, best_time);
+    }
+
+    base = best;
+    for (double scale : {0.5, 2.0, 4.0})
+    {
+        TunedParameters candidate = base;
+        candidate.sieve_interval = static_cast<unsigned long>(base.sieve_interval * scale);
+        try_parameters(numbers, candidate, best, best_time);
+    }
+
+    base = best;
+    for (double slack : {0.7, 0.85, 1.15, 1.3})
+    {
+        TunedParameters candidate = base;
+        candidate.threshold_slack = slack;
+        try_parameters(numbers, candidate, best, best_time);
+    }
+
+    base = best;
+    for (size_t extra : {5, 10, 50})
+    {
+        TunedParameters candidate = base;
+        candidate.extra_relations = extra;
+        try_parameters(numbers, candidate, best, best_time);
+    }
+
+    return best;
+}
+
+int run_autotune(const string &path, vector<mpz_class> numbers)
+{
+    if (numbers.empty())
+    {
+        for (unsigned int digits = AUTOTUNE_MIN_DIGITS; digits <= AUTOTUNE_MAX_DIGITS; digits += AUTOTUNE_DIGIT_STEP)
+        {
+            vector<mpz_class> generated = generate_semiprimes(digits, AUTOTUNE_SAMPLES, AUTOTUNE_SEED + digits);
+            numbers.insert(numbers.end(), generated.begin(), generated.end());
+        }
+    }
+
+    map<unsigned int, vector<mpz_class>> sizes;
+    for (const mpz_class &n : numbers)
+        sizes[n.get_str().size()].push_back(n);
+
+    vector<TunedParameters> table;
+    for (map<unsigned int, vector<mpz_class>>::const_iterator it = sizes.begin(); it != sizes.end(); ++it)
+    {
+        table.push_back(tune_size(it->first, it->second));
+    }
+
+    if (!write_parameter_table(path, table))
+    {
+        cerr << "Error: could not write " << path << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Wrote parameters for " << table.size() << " sizes to " << path << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <gmpxx.h>
+#include <string>
+#include <vector>
+
+// Semiprimes with the given number of digits, each the product of two primes of about half that size
+std::vector<mpz_class> generate_semiprimes(unsigned int digits, unsigned int count, unsigned long seed);
+
+// Times the factorisation of the numbers, grouped by digit count, while sweeping the smoothness bound, the sieve
+// interval, the threshold slack and the extra relations one after the other (each sweep keeps the fastest value
+// before moving on to the next), then writes the best parameters of each size to the table at path.
+// Without numbers, AUTOTUNE_SAMPLES semiprimes are generated for each size from AUTOTUNE_MIN_DIGITS to
+// AUTOTUNE_MAX_DIGITS
+int run_autotune(const std::string &path, std::vector<mpz_class> numbers);
+
+#endif // AUTOTUNE_H
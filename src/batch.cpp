@@ -0,0 +1,84 @@
+#include "batch.h"
+#include "factorize.h"
+#include "config.h"
+#include <omp.h>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Factors one number quietly and formats its result line
+static string batch_result(const string &input)
+{
+    auto start = chrono::high_resolution_clock::now();
+    ostringstream line;
+    line << "n=" << input;
+
+    string error;
+    Factorization factors;
+    bool valid = !input.empty() && input.size() <= MAX_DIGITS;
+    for (char c : input)
+        valid = valid && isdigit(static_cast<unsigned char>(c));
+
+    if (!valid)
+    {
+        error = "Invalid input, expected a number of at most " + to_string(MAX_DIGITS) + " digits.";
+    }
+    else
+    {
+        // Jobs run side by side, so no progress output and no shared checkpoint file
+        Options options;
+        options.verbose = false;
+        options.checkpoints = false;
+        factorize(mpz_class(input), factors, options, error);
+    }
+
+    if (error.empty())
+    {
+        line << " factors=" << format_factorization(factors, ",");
+    }
+    else
+    {
+        line << " error=\"" << error << "\"";
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    line << " time=" << fixed << setprecision(6) << chrono::duration_cast<chrono::microseconds>(end - start).count() / 1e6;
+    return line.str();
+}
+
+int run_batch(istream &in, ostream &out)
+{
+    vector<string> side_by_side, solo;
+    string line;
+    while (getline(in, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#')
+            continue;
+        string input = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+        (input.size() < BATCH_SOLO_DIGITS ? side_by_side : solo).push_back(input);
+    }
+
+    // Small numbers don't keep many threads busy on their own, so each one gets a thread
+    // (the parallel loops inside run on that thread alone)
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < side_by_side.size(); i++)
+    {
+        string result = batch_result(side_by_side[i]);
+#pragma omp critical(batch_output)
+        out << result << endl;
+    }
+
+    for (size_t i = 0; i < solo.size(); i++)
+    {
+        out << batch_result(solo[i]) << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
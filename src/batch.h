@@ -0,0 +1,13 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <iostream>
+
+// Reads numbers one per line (blank lines and lines starting with # are skipped) and writes one line per number:
+//   n=<N> factors=<f1>,<f2>,... time=<seconds>
+//   n=<N> error="<reason>" time=<seconds>
+// in the order they finish. Numbers with fewer than BATCH_SOLO_DIGITS digits are factored side by side with a
+// thread each, larger ones one after the other with every thread
+int run_batch(std::istream &in, std::ostream &out);
+
+#endif // BATCH_H
@@ -0,0 +1,287 @@
+#include "factorize.h"
+#include "autotune.h"
+#include "config.h"
+#include "scan.h"
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Medians over the runs of one number of the corpus
+struct BenchmarkResult
+{
+    unsigned int digits;
+    mpz_class n;
+    bool ok;              // every run found factors multiplying back to n
+    PhaseTimes median;    // median of each phase separately
+    vector<double> totals; // total time of each run
+};
+
+static double median(vector<double> values)
+{
+    sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return (values.size() % 2) ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+static BenchmarkResult run_benchmark(unsigned int digits, const mpz_class &n, int runs)
+{
+    BenchmarkResult result;
+    result.digits = digits;
+    result.n = n;
+    result.ok = true;
+
+    vector<PhaseTimes> times(runs);
+    for (int r = 0; r < runs; r++)
+    {
+        // Same parameters on every machine: no checkpoints and no tuned table
+        Options options;
+        options.verbose = false;
+        options.checkpoints = false;
+        options.parameter_file = "";
+        options.timings = &times[r];
+
+        Factorization factors;
+        string error;
+        mpz_class product = 1;
+        if (factorize(n, factors, options, error))
+        {
+            for (const pair<const mpz_class, unsigned int> &f : factors)
+            {
+                mpz_class power;
+                mpz_pow_ui(power.get_mpz_t(), f.first.get_mpz_t(), f.second);
+                product *= power;
+            }
+        }
+        result.ok = result.ok && product == n;
+        result.totals.push_back(times[r].total);
+    }
+
+    vector<double> factor_base, sieving, verification, linear_algebra, square_root, relations, polynomials;
+    for (const PhaseTimes &t : times)
+    {
+        factor_base.push_back(t.factor_base);
+        sieving.push_back(t.sieving);
+        verification.push_back(t.verification);
+        linear_algebra.push_back(t.linear_algebra);
+        square_root.push_back(t.square_root);
+        relations.push_back(t.relations);
+        polynomials.push_back(t.polynomials);
+    }
+    result.median.factor_base = median(factor_base);
+    result.median.sieving = median(sieving);
+    result.median.verification = median(verification);
+    result.median.linear_algebra = median(linear_algebra);
+    result.median.square_root = median(square_root);
+    result.median.total = median(result.totals);
+    result.median.relations = static_cast<size_t>(median(relations));
+    result.median.polynomials = static_cast<unsigned long>(median(polynomials));
+    return result;
+}
+
+// Relations collected per second of sieving
+static double relations_per_second(const PhaseTimes &t)
+{
+    return t.sieving > 0 ? t.relations / t.sieving : 0;
+}
+
+// Each result goes on a line of its own so that read_baseline can pick it up without a JSON parser
+static bool write_json(const string &path, const vector<BenchmarkResult> &results, int runs, int threads)
+{
+    ofstream out(path.c_str());
+    if (!out)
+        return false;
+
+    out << fixed << setprecision(6);
+    out << "{\n  \"seed\": " << BENCHMARK_SEED << ",\n  \"runs\": " << runs << ",\n  \"threads\": " << threads
+        << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &r = results[i];
+        out << "    {\"digits\": " << r.digits << ", \"n\": \"" << r.n.get_str() << "\", \"ok\": "
+            << (r.ok ? "true" : "false") << ", \"total\": " << r.median.total
+            << ", \"factor_base\": " << r.median.factor_base << ", \"sieving\": " << r.median.sieving
+            << ", \"verification\": " << r.median.verification << ", \"linear_algebra\": " << r.median.linear_algebra
+            << ", \"square_root\": " << r.median.square_root << ", \"relations\": " << r.median.relations
+            << ", \"polynomials\": " << r.median.polynomials
+            << ", \"relations_per_second\": " << relations_per_second(r.median) << ", \"runs\": [";
+        for (size_t k = 0; k < r.totals.size(); k++)
+            out << (k ? ", " : "") << r.totals[k];
+        out << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Value of "key": in a line written by write_json
+static bool json_number(const string &line, const string &key, double &value)
+{
+    size_t pos = line.find("\"" + key + "\": ");
+    if (pos == string::npos)
+        return false;
+    istringstream field(line.substr(pos + key.size() + 4));
+    return static_cast<bool>(field >> value);
+}
+
+// Median total time of each size in a file written by write_json
+static bool read_baseline(const string &path, map<unsigned int, double> &totals)
+{
+    ifstream in(path.c_str());
+    if (!in)
+        return false;
+
+    string line;
+    while (getline(in, line))
+    {
+        double digits, total;
+        if (json_number(line, "digits", digits) && json_number(line, "total", total))
+            totals[static_cast<unsigned int>(digits)] = total;
+    }
+    return true;
+}
+
+// Microbenchmark of the threshold scan kernels over synthetic sieve blocks: mostly values well below the threshold
+// with about one position in 2000 reaching it, as in a real sieve. Returns false if a kernel disagrees with the
+// scalar scan
+static bool run_scan_benchmark()
+{
+    const size_t blocks = 256;
+    const int passes = 20;
+    const unsigned char threshold = 60;
+
+    mt19937 rng(BENCHMARK_SEED);
+    vector<unsigned char> data(blocks * SIEVE_BLOCK_SIZE);
+    for (unsigned char &value : data)
+        value = (rng() % 2000 == 0) ? threshold + rng() % 10 : 10 + rng() % 40;
+
+    vector<unsigned long> expected, positions;
+    double scalar_seconds = 0;
+    bool ok = true;
+
+    cout << setw(8) << "kernel" << setw(10) << "GB/s" << setw(10) << "speedup" << setw(12) << "candidates" << endl;
+    for (int k = SCAN_SCALAR; k < SCAN_KERNELS; k++)
+    {
+        ScanKernel kernel = static_cast<ScanKernel>(k);
+        if (!scan_kernel_supported(kernel))
+        {
+            cout << setw(8) << scan_kernel_name(kernel) << "  not supported" << endl;
+            continue;
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++)
+        {
+            positions.clear();
+            for (size_t b = 0; b < blocks; b++)
+                scan_bytes(kernel, &data[b * SIEVE_BLOCK_SIZE], SIEVE_BLOCK_SIZE, threshold, b * SIEVE_BLOCK_SIZE,
+                           positions);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (kernel == SCAN_SCALAR)
+        {
+            expected = positions;
+            scalar_seconds = seconds;
+        }
+        bool same = positions == expected;
+        ok = ok && same;
+
+        cout << setw(8) << scan_kernel_name(kernel) << fixed << setprecision(2) << setw(10)
+             << passes * data.size() / seconds / 1e9 << setw(9) << scalar_seconds / seconds << "x" << setw(12)
+             << positions.size() << (same ? "" : "  WRONG") << (kernel == best_scan_kernel() ? "  (used)" : "")
+             << endl;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = BENCHMARK_RUNS;
+    unsigned int max_digits = BENCHMARK_MAX_DIGITS;
+    string output = "benchmark.json";
+    string baseline;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = max(1, atoi(argv[++i]));
+        else if (arg == "--max-digits" && i + 1 < argc)
+            max_digits = atoi(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc)
+            baseline = argv[++i];
+        else if (arg == "--scan" && argc == 2)
+            return run_scan_benchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+        else
+        {
+            cerr << "Usage: " << argv[0]
+                 << " [--scan | [--runs <n>] [--max-digits <d>] [--output <json>] [--baseline <json>]]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    map<unsigned int, double> baseline_totals;
+    if (!baseline.empty() && !read_baseline(baseline, baseline_totals))
+    {
+        cerr << "Error: could not read " << baseline << endl;
+        return EXIT_FAILURE;
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    cout << setw(6) << "digits" << setw(10) << "total" << setw(10) << "fb" << setw(10) << "sieve" << setw(10)
+         << "verify" << setw(10) << "linalg" << setw(10) << "sqrt" << setw(12) << "rels/s" << "  status" << endl;
+
+    // The corpus only depends on BENCHMARK_SEED, so every machine and every build factors the same numbers
+    vector<BenchmarkResult> results;
+    bool failed = false;
+    for (unsigned int digits = BENCHMARK_MIN_DIGITS; digits <= max_digits; digits += BENCHMARK_DIGIT_STEP)
+    {
+        mpz_class n = generate_semiprimes(digits, 1, BENCHMARK_SEED + digits)[0];
+        BenchmarkResult r = run_benchmark(digits, n, runs);
+        results.push_back(r);
+
+        string status = r.ok ? "ok" : "FAILED";
+        map<unsigned int, double>::const_iterator base = baseline_totals.find(digits);
+        if (base != baseline_totals.end())
+        {
+            // Differences of a few milliseconds are noise whatever the tolerance
+            double change = r.median.total - base->second;
+            ostringstream note;
+            note << fixed << setprecision(1) << (base->second > 0 ? 100 * change / base->second : 0) << "%";
+            bool regression = change > BENCHMARK_TOLERANCE * base->second && change > 0.01;
+            status += (regression ? " REGRESSION " : " ") + note.str();
+            failed = failed || regression;
+        }
+        failed = failed || !r.ok;
+
+        cout << fixed << setprecision(3) << setw(6) << digits << setw(10) << r.median.total << setw(10)
+             << r.median.factor_base << setw(10) << r.median.sieving << setw(10) << r.median.verification << setw(10)
+             << r.median.linear_algebra << setw(10) << r.median.square_root << setw(12) << setprecision(0)
+             << relations_per_second(r.median) << "  " << status << endl;
+    }
+
+    if (!write_json(output, results, runs, threads))
+    {
+        cerr << "Error: could not write " << output << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Results written to " << output << endl;
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include "checkpoint.h"
+#include "config.h"
+#include "serialize.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char LOG_MAGIC[8] = {'Q', 'S', 'R', 'E', 'L', 'S', '2', '\n'};
+
+// Record types following the header
+static const unsigned char RECORD_RELATION = 'R';
+static const unsigned char RECORD_PARTIAL = 'P';
+static const unsigned char RECORD_PROGRESS = 'C';
+
+// Identifies the run, a file is only resumed if its header matches byte for byte
+static vector<unsigned char> log_header(const mpz_class &N,
+                                        unsigned long B,
+                                        const FactorBase &factor_base,
+                                        unsigned long sieve_interval,
+                                        uint64_t seed)
+{
+    vector<unsigned char> header(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC));
+    put_mpz(header, N);
+    put_u64(header, B);
+    put_u64(header, factor_base.size());
+    put_u64(header, factor_base.primes.empty() ? 0 : factor_base.primes.back());
+    put_u64(header, large_prime_bound(factor_base));
+    put_u64(header, double_large_prime_bound(factor_base, N));
+    put_u64(header, sieve_interval);
+    put_u64(header, seed);
+    return header;
+}
+
+// Loads the records up to the last progress record, returns how many bytes they take (0 if there is none)
+static size_t load_records(ByteReader reader,
+                           const mpz_class &N,
+                           vector<Relation> &relations,
+                           PartialRelations &partials,
+                           SieveProgress &progress)
+{
+    const unsigned char *begin = reader.pos;
+    size_t committed = 0;
+    vector<Relation> pending_relations, pending_partials;
+
+    uint8_t type;
+    while (reader.u8(type))
+    {
+        if (type == RECORD_RELATION || type == RECORD_PARTIAL)
+        {
+            Relation rel;
+            if (!reader.relation(rel))
+                break;
+            (type == RECORD_RELATION ? pending_relations : pending_partials).push_back(rel);
+        }
+        else if (type == RECORD_PROGRESS)
+        {
+            uint8_t use_siqs;
+            uint64_t polynomials, sieve_interval;
+            mpz_class start_x;
+            if (!reader.u8(use_siqs) || !reader.u64(polynomials) || !reader.u64(sieve_interval) || !reader.mpz(start_x))
+                break;
+
+            relations.insert(relations.end(), pending_relations.begin(), pending_relations.end());
+
+            // The partials were edges of the forest when they were written, so adding them
+            // again in the same order rebuilds the graph without finding any cycles
+            for (const Relation &rel : pending_partials)
+            {
+                Relation full;
+                if (add_partial_relation(partials, rel, N, full))
+                    relations.push_back(full);
+            }
+            pending_relations.clear();
+            pending_partials.clear();
+
+            progress.use_siqs = use_siqs;
+            progress.polynomials = polynomials;
+            progress.sieve_interval = sieve_interval;
+            progress.start_x = start_x;
+            committed = reader.pos - begin;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return committed;
+}
+
+bool open_relation_log(RelationLog &log,
+                       const string &path,
+                       const mpz_class &N,
+                       unsigned long B,
+                       const FactorBase &factor_base,
+                       unsigned long sieve_interval,
+                       uint64_t seed,
+                       vector<Relation> &relations,
+                       PartialRelations &partials)
+{
+    log.path = path;
+    vector<unsigned char> header = log_header(N, B, factor_base, sieve_interval, seed);
+
+    // Map an existing file rather than reading it, it can be large and is only scanned once
+    size_t committed = 0;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > header.size())
+        {
+            void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                const unsigned char *bytes = static_cast<const unsigned char *>(data);
+                if (memcmp(bytes, &header[0], header.size()) == 0)
+                {
+                    ByteReader reader = {bytes + header.size(), bytes + st.st_size};
+                    committed = load_records(reader, N, relations, partials, log.progress);
+                }
+                munmap(data, st.st_size);
+            }
+        }
+        close(fd);
+    }
+
+    bool resumed = committed > 0;
+    if (resumed)
+    { // Drop anything written after the last checkpoint, it will be sieved again
+        if (truncate(path.c_str(), header.size() + committed) != 0)
+            cerr << "Warning: could not truncate relation file " << path << endl;
+        log.file = fopen(path.c_str(), "ab");
+    }
+    else
+    {
+        log.file = fopen(path.c_str(), "wb");
+        if (log.file)
+        {
+            fwrite(&header[0], 1, header.size(), log.file);
+            fflush(log.file);
+        }
+    }
+
+    if (!log.file)
+        cerr << "Warning: could not open relation file " << path << ", continuing without checkpoints." << endl;
+
+    log.relations_written = relations.size();
+    log.partials_written = partials.relations.size();
+    return resumed;
+}
+
+void write_checkpoint(RelationLog &log, const vector<Relation> &relations, const PartialRelations &partials)
+{
+    if (!log.file)
+        return;
+
+    vector<unsigned char> buf;
+    for (size_t i = log.relations_written; i < relations.size(); i++)
+    {
+        put_u8(buf, RECORD_RELATION);
+        put_relation(buf, relations[i]);
+    }
+    for (size_t i = log.partials_written; i < partials.relations.size(); i++)
+    {
+        put_u8(buf, RECORD_PARTIAL);
+        put_relation(buf, partials.relations[i]);
+    }
+
+    put_u8(buf, RECORD_PROGRESS);
+    put_u8(buf, log.progress.use_siqs);
+    put_u64(buf, log.progress.polynomials);
+    put_u64(buf, log.progress.sieve_interval);
+    put_mpz(buf, log.progress.start_x);
+
+    fwrite(&buf[0], 1, buf.size(), log.file);
+    fflush(log.file);
+
+    log.relations_written = relations.size();
+    log.partials_written = partials.relations.size();
+}
+
+void close_relation_log(RelationLog &log, bool remove_file)
+{
+    if (log.file)
+    {
+        fclose(log.file);
+        log.file = NULL;
+        if (remove_file)
+            remove(log.path.c_str());
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <gmpxx.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "smooth_relations.h"
+#include "large_prime.h"
+#include "factors.h"
+
+// Where sieving had got to at the last checkpoint
+struct SieveProgress
+{
+    bool use_siqs;                // sieving SIQS polynomials rather than x^2 - N
+    unsigned long polynomials;    // SIQS polynomials sieved so far
+    unsigned long sieve_interval; // current sieve interval
+    mpz_class start_x;            // next x for the x^2 - N sieve
+
+    SieveProgress() : use_siqs(false), polynomials(0), sieve_interval(0) {}
+};
+
+// Append-only binary file with a header identifying the run (N, B, the factor base and sieve parameters),
+// followed by full relations, the partial relations kept in the large prime graph and progress records.
+// Only what comes before the last progress record is used on a restart
+struct RelationLog
+{
+    FILE *file;
+    std::string path;
+    size_t relations_written; // relations already in the file
+    size_t partials_written;  // partial relations already in the file
+    SieveProgress progress;   // written with the next checkpoint
+
+    RelationLog() : file(NULL), relations_written(0), partials_written(0) {}
+};
+
+// Opens the relation file at path. If it was written for the same run, its relations and partial relations
+// are loaded (through a memory mapping) and the progress is restored, and true is returned.
+// Otherwise a new file is started
+bool open_relation_log(RelationLog &log,
+                       const std::string &path,
+                       const mpz_class &N,
+                       unsigned long B,
+                       const FactorBase &factor_base,
+                       unsigned long sieve_interval,
+                       uint64_t seed,
+                       std::vector<Relation> &relations,
+                       PartialRelations &partials);
+
+// Appends the relations and partial relations found since the last checkpoint, then the progress
+void write_checkpoint(RelationLog &log, const std::vector<Relation> &relations, const PartialRelations &partials);
+
+// Closes the file, removing it once the run has finished
+void close_relation_log(RelationLog &log, bool remove_file);
+
+#endif // CHECKPOINT_H
@@ -2,7 +2,7 @@
 #define CONFIG_H
 
 // Maximum number of digits allowed for the composite number
-#define MAX_DIGITS 60
+#define MAX_DIGITS 70
 
 // Constant for the smoothness bound
 #define B_CONSTANT 0.05
@@ -19,8 +19,153 @@
 // Minimum smoothness bound
 #define MIN_SMOOTHNESS_BOUND 1000
 
+// Sieve k * n for a small multiplier k chosen with the Knuth-Schroeppel function, for more small primes in the factor base
+#define USE_MULTIPLIER 1
+
+// Largest multiplier tried
+#define MAX_MULTIPLIER 97
+
+// Primes up to this are used to score each multiplier
+#define MULTIPLIER_PRIMES 2000
+
 // Sieve Interval
 #define SIEVE_INTERVAL 10000
 #define MAX_SIEVE_INTERVAL 10000000
 
+// Size in bytes of each sieve block, chosen to fit in the L1 data cache
+#define SIEVE_BLOCK_SIZE 32768
+
+// Factor base primes from this size hit a block at most a few times, and are sieved through per-block buckets
+#define BUCKET_SIEVE_MIN_PRIME SIEVE_BLOCK_SIZE
+
+// Blocks of x^2 - n whose bucket hits are collected at a time, which bounds the memory used whatever the interval
+#define BUCKET_CHUNK_BLOCKS 64
+
+// Numbers per segment when sieving the primes up to the smoothness bound
+#define PRIME_SIEVE_SEGMENT 262144
+
+// Sieve threshold slack in multiples of log(largest factor base prime)
+#define SIEVE_THRESHOLD_SLACK 1.0
+
+// Factor base primes below this are not sieved (small prime variation), the threshold allows for their expected size
+#define SMALL_PRIME_CUTOFF 40
+
+// Also trial divide a sample of the positions below the sieve threshold to count the relations it misses
+#define SIEVE_THRESHOLD_STATS 0
+
+// One in this many sieve positions is sampled when SIEVE_THRESHOLD_STATS is set
+#define SIEVE_STATS_SAMPLE 1024
+
+// Keep relations with one prime factor above the smoothness bound and combine pairs sharing it
+#define USE_LARGE_PRIMES 1
+
+// Largest prime allowed in a partial relation, as a multiple of the largest factor base prime
+#define LARGE_PRIME_MULTIPLIER 64
+
+// Also keep relations whose cofactor splits into two large primes, and find cycles in the large prime graph
+#define USE_DOUBLE_LARGE_PRIMES 1
+
+// Minimum number of digits for which double large primes are used
+#define DOUBLE_LARGE_PRIME_MIN_DIGITS 65
+
+// Largest cofactor split into two large primes, as a power of the single large prime bound
+#define DOUBLE_LARGE_PRIME_EXPONENT 1.8
+
+// Use the self-initializing quadratic sieve (many polynomials) instead of only sieving x^2 - N
+#define USE_SIQS 1
+
+// Minimum number of digits for which SIQS is used
+#define SIQS_MIN_DIGITS 20
+
+// Constant for the smoothness bound when using SIQS
+#define SIQS_B_CONSTANT -0.03
+
+// SIQS sieve interval, each polynomial is sieved over [-M, M) with M = SIQS_SIEVE_INTERVAL / 2
+#define SIQS_SIEVE_INTERVAL 65536
+
+// Approximate size of the factor base primes whose product is the SIQS coefficient a
+#define SIQS_A_PRIME_SIZE 2000
+
+// Number of random tries when choosing the SIQS coefficient a
+#define SIQS_A_TRIES 30
+
+// Seed for the random choice of the SIQS coefficient a
+#define SIQS_SEED 1
+
+// Number of relations to collect beyond the size of the factor base
+#define SIQS_EXTRA_RELATIONS 20
+
+// Polynomials sieved together per thread. Each (polynomial, block) pair of a batch is a separate work item,
+// so threads keep busy even though a polynomial only spans a few blocks
+#define SIQS_BATCH_POLYNOMIALS 4
+
+
+// Filter the relations (duplicates, singletons, excess, merges) before the linear algebra
+#define USE_FILTERING 1
+
+// Relations kept beyond the number of columns in use after filtering (0 keeps them all)
+#define FILTER_MAX_EXCESS 128
+
+// Merge columns used by at most this many relations
+#define FILTER_MERGE_MAX_WEIGHT 3
+
+// Stream relations to an append-only file and resume from it after a restart (command line only,
+// factor() and factorize() take Options::checkpoints)
+#define USE_CHECKPOINT 1
+
+// Relation file used for checkpoints, in the working directory
+#define CHECKPOINT_FILE "qs_relations.bin"
+
+// SIQS polynomials sieved between checkpoints
+#define CHECKPOINT_POLYNOMIALS 100
+
+// Largest message accepted from the other end of a distributed sieving connection, in bytes
+#define MAX_MESSAGE_BYTES (64 << 20)
+
+// In batch mode, numbers with at least this many digits are factored one at a time with every thread,
+// smaller ones side by side with one thread each
+#define BATCH_SOLO_DIGITS 50
+
+// Parameter table written by --autotune, used in place of the smoothness bound, sieve interval, threshold slack
+// and extra relations above for numbers of the sizes it covers (ignored if the file doesn't exist)
+#define PARAMETER_FILE "qs_params.txt"
+
+// Digit counts tuned by --autotune, from AUTOTUNE_MIN_DIGITS to AUTOTUNE_MAX_DIGITS in steps of AUTOTUNE_DIGIT_STEP
+#define AUTOTUNE_MIN_DIGITS 20
+#define AUTOTUNE_MAX_DIGITS 60
+#define AUTOTUNE_DIGIT_STEP 5
+
+// Semiprimes generated for each digit count, and the seed used to generate them
+#define AUTOTUNE_SAMPLES 3
+#define AUTOTUNE_SEED 1
+
+// Sieve and linear algebra counters are written to this file while factoring and when done, as Prometheus text
+// if the name ends in .prom and JSON otherwise ("" to turn it off, --telemetry sets it from the command line)
+#define TELEMETRY_FILE ""
+
+// Seconds between two writes of the telemetry file
+#define TELEMETRY_INTERVAL 10
+
+// Benchmark corpus (make benchmark): one balanced semiprime per BENCHMARK_DIGIT_STEP digits
+// from BENCHMARK_MIN_DIGITS to BENCHMARK_MAX_DIGITS, generated from BENCHMARK_SEED
+#define BENCHMARK_MIN_DIGITS 20
+#define BENCHMARK_MAX_DIGITS 65
+#define BENCHMARK_DIGIT_STEP 5
+#define BENCHMARK_SEED 2024
+
+// Runs of each benchmark number, the median of each phase is reported
+#define BENCHMARK_RUNS 3
+
+// A median total time slower than the baseline by more than this fraction is reported as a regression
+#define BENCHMARK_TOLERANCE 0.15
+
+// Use Block Lanczos instead of Gaussian elimination from this many relations
+#define LANCZOS_MIN_RELATIONS 2000
+
+// Number of random starts to try before Block Lanczos gives up
+#define LANCZOS_RETRIES 3
+
+// Seed for the random start of Block Lanczos
+#define LANCZOS_SEED 1
+
 #endif // CONFIG_H
\ No newline at end of file
@@ -0,0 +1,461 @@
+#include "distributed.h"
+#include "serialize.h"
+#include "siqs.h"
+#include "config.h"
+#include "verbose.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <csignal>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+// Every message is a type byte and a payload length followed by the payload
+static const uint8_t MSG_JOB = 'J';     // coordinator -> worker: kN, B, k, sieve interval, seed, threshold slack
+static const uint8_t MSG_UNIT = 'U';    // coordinator -> worker: unit to sieve
+static const uint8_t MSG_DONE = 'D';    // coordinator -> worker: stop
+static const uint8_t MSG_WANT = 'W';    // worker -> coordinator: ready for a unit (answered by a unit, or by
+                                        // the next job if the worker's is out of date)
+static const uint8_t MSG_RESULT = 'R';  // worker -> coordinator: unit, relations and partial relations
+
+static bool write_all(int fd, const unsigned char *data, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t written = write(fd, data, count);
+        if (written <= 0)
+            return false;
+        data += written;
+        count -= written;
+    }
+    return true;
+}
+
+static bool read_all(int fd, unsigned char *data, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t got = read(fd, data, count);
+        if (got <= 0)
+            return false;
+        data += got;
+        count -= got;
+    }
+    return true;
+}
+
+static bool send_message(int fd, uint8_t type, const vector<unsigned char> &payload)
+{
+    vector<unsigned char> buf;
+    put_u8(buf, type);
+    put_u32(buf, payload.size());
+    buf.insert(buf.end(), payload.begin(), payload.end());
+    return write_all(fd, &buf[0], buf.size());
+}
+
+static bool receive_message(int fd, uint8_t &type, vector<unsigned char> &payload)
+{
+    unsigned char head[5];
+    if (!read_all(fd, head, sizeof(head)))
+        return false;
+
+    ByteReader reader = {head, head + sizeof(head)};
+    uint32_t length;
+    reader.u8(type);
+    reader.u32(length);
+
+    // A garbled or hostile header shouldn't make us allocate gigabytes
+    if (length > MAX_MESSAGE_BYTES)
+        return false;
+
+    payload.resize(length);
+    return length == 0 || read_all(fd, &payload[0], length);
+}
+
+bool start_coordinator(Coordinator &coordinator, unsigned short port)
+{
+    signal(SIGPIPE, SIG_IGN); // a worker going away shows up as a failed write
+
+    coordinator.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (coordinator.listen_fd < 0)
+        return false;
+
+    int yes = 1;
+    setsockopt(coordinator.listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(coordinator.listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(coordinator.listen_fd, 64) != 0)
+    {
+        cerr << "Error: could not listen on port " << port << ": " << strerror(errno) << endl;
+        close(coordinator.listen_fd);
+        coordinator.listen_fd = -1;
+        return false;
+    }
+
+    cout << "Coordinator listening on port " << port << ", start workers with --worker <host> " << port << endl;
+    return true;
+}
+
+void set_coordinator_job(Coordinator &coordinator,
+                         const mpz_class &N,
+                         unsigned long B,
+                         unsigned long multiplier,
+                         unsigned long sieve_interval,
+                         uint64_t seed,
+                         double threshold_slack)
+{
+    coordinator.job.clear();
+    put_mpz(coordinator.job, N);
+    put_u64(coordinator.job, B);
+    put_u64(coordinator.job, multiplier);
+    put_u64(coordinator.job, sieve_interval);
+    put_u64(coordinator.job, seed);
+    put_f64(coordinator.job, threshold_slack);
+
+    // Units are numbered from 0 again for the new job, and nothing of the old one is kept
+    coordinator.job_id++;
+    coordinator.requeued.clear();
+    coordinator.next_unit = 0;
+    coordinator.units_done = 0;
+    coordinator.seen.clear();
+    for (map<int, long>::iterator it = coordinator.workers.begin(); it != coordinator.workers.end(); ++it)
+        it->second = -1;
+
+    if (verbose() && !coordinator.workers.empty())
+        cout << "Coordinator: handing " << coordinator.workers.size() << " workers the next job." << endl;
+}
+
+// Closes a worker's socket, its unit goes to the next worker asking for one
+static void drop_worker(Coordinator &coordinator, int fd)
+{
+    map<int, long>::iterator it = coordinator.workers.find(fd);
+    if (it == coordinator.workers.end())
+        return;
+    if (it->second >= 0 && coordinator.worker_jobs[fd] == coordinator.job_id)
+        coordinator.requeued.push_back(it->second);
+    coordinator.workers.erase(it);
+    coordinator.worker_jobs.erase(fd);
+    close(fd);
+
+    if (verbose())
+        cout << "Coordinator: worker disconnected, " << coordinator.workers.size() << " left." << endl;
+}
+
+// Checks that x^2 = Q (mod N) with Q given by the relation's factors, so a faulty worker can't poison the matrix
+static bool relation_holds(const Relation &rel, const FactorBase &factor_base, const mpz_class &N)
+{
+    mpz_class q = 1, power;
+    for (const pair<unsigned int, unsigned int> &f : rel.factors)
+    {
+        if (f.first > factor_base.size())
+            return false;
+        if (f.first == 0)
+        {
+            if (f.second % 2 == 1)
+                q = -q;
+            continue;
+        }
+        mpz_class p = factor_base.primes[f.first - 1];
+        mpz_powm_ui(power.get_mpz_t(), p.get_mpz_t(), f.second, N.get_mpz_t());
+        q = (q * power) % N;
+    }
+    for (unsigned long prime : rel.large_primes)
+        q = (q * prime) % N;
+
+    mpz_class lhs = (rel.x * rel.x - q) % N;
+    return lhs == 0;
+}
+
+// Adds the relations of a unit, returns false if the message is malformed or a relation doesn't hold
+static bool add_results(Coordinator &coordinator,
+                        const vector<unsigned char> &payload,
+                        const mpz_class &N,
+                        const FactorBase &factor_base,
+                        vector<Relation> &relations,
+                        PartialRelations &partials)
+{
+    ByteReader reader = {payload.empty() ? NULL : &payload[0], payload.empty() ? NULL : &payload[0] + payload.size()};
+    uint64_t unit;
+    uint32_t count;
+    if (!reader.u64(unit))
+        return false;
+
+    // Full relations first, then partial relations
+    for (int kind = 0; kind < 2; kind++)
+    {
+        if (!reader.u32(count))
+            return false;
+        for (uint32_t k = 0; k < count; k++)
+        {
+            Relation rel;
+            if (!reader.relation(rel) || !relation_holds(rel, factor_base, N))
+                return false;
+
+            // Units can pick the same a, and a relation found twice is of no use
+            if (!coordinator.seen.insert(rel.x).second)
+                continue;
+
+            Relation full;
+            if (kind == 0 || rel.large_primes.empty())
+                relations.push_back(rel);
+            else if (add_partial_relation(partials, rel, N, full))
+                relations.push_back(full);
+        }
+    }
+    return true;
+}
+
+vector<Relation> collect_distributed_relations(Coordinator &coordinator,
+                                               const mpz_class &N,
+                                               const FactorBase &factor_base,
+                                               vector<Relation> &existing_relations,
+                                               PartialRelations &partials)
+{
+    vector<Relation> relations = existing_relations; // Start with existing relations
+    size_t target = max(factor_base.size() + coordinator.extra_relations,
+                        existing_relations.size() + coordinator.extra_relations);
+
+    while (relations.size() < target && !(coordinator.cancel && *coordinator.cancel))
+    {
+        vector<pollfd> fds(1);
+        fds[0].fd = coordinator.listen_fd;
+        fds[0].events = POLLIN;
+        for (map<int, long>::const_iterator it = coordinator.workers.begin(); it != coordinator.workers.end(); ++it)
+        {
+            pollfd p;
+            p.fd = it->first;
+            p.events = POLLIN;
+            fds.push_back(p);
+        }
+
+        if (poll(&fds[0], fds.size(), 1000) <= 0)
+            continue;
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(coordinator.listen_fd, NULL, NULL);
+            if (fd >= 0)
+            {
+                int yes = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                if (send_message(fd, MSG_JOB, coordinator.job))
+                {
+                    coordinator.workers[fd] = -1;
+                    coordinator.worker_jobs[fd] = coordinator.job_id;
+                    if (verbose())
+                        cout << "Coordinator: worker connected, " << coordinator.workers.size() << " in total." << endl;
+                }
+                else
+                {
+                    close(fd);
+                }
+            }
+        }
+
+        for (size_t k = 1; k < fds.size(); k++)
+        {
+            if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            int fd = fds[k].fd;
+            uint8_t type;
+            vector<unsigned char> payload;
+            if (!receive_message(fd, type, payload))
+            {
+                drop_worker(coordinator, fd);
+                continue;
+            }
+
+            if (type == MSG_WANT && coordinator.worker_jobs[fd] != coordinator.job_id)
+            { // The worker finished with an earlier job, give it this one
+                coordinator.workers[fd] = -1;
+                coordinator.worker_jobs[fd] = coordinator.job_id;
+                if (!send_message(fd, MSG_JOB, coordinator.job))
+                    drop_worker(coordinator, fd);
+            }
+            else if (type == MSG_RESULT && coordinator.worker_jobs[fd] != coordinator.job_id)
+            { // A unit of an earlier job, its relations are for another number
+                coordinator.workers[fd] = -1;
+            }
+            else if (type == MSG_WANT)
+            {
+                unsigned long unit;
+                if (!coordinator.requeued.empty())
+                {
+                    unit = coordinator.requeued.back();
+                    coordinator.requeued.pop_back();
+                }
+                else
+                {
+                    unit = coordinator.next_unit++;
+                }
+
+                vector<unsigned char> message;
+                put_u64(message, unit);
+                coordinator.workers[fd] = unit;
+                if (!send_message(fd, MSG_UNIT, message))
+                    drop_worker(coordinator, fd);
+            }
+            else if (type == MSG_RESULT && add_results(coordinator, payload, N, factor_base, relations, partials))
+            {
+                coordinator.workers[fd] = -1;
+                coordinator.units_done++;
+                if (verbose() && coordinator.units_done % 10 == 0)
+                {
+                    cout << "Coordinator: " << coordinator.units_done << " units from " << coordinator.workers.size()
+                         << " workers, " << relations.size() << " of " << target << " relations ("
+                         << partials.combined_count << " from " << partials.partial_count << " partials)." << endl;
+                }
+            }
+            else
+            {
+                cerr << "Coordinator: unexpected message from a worker, dropping it." << endl;
+                drop_worker(coordinator, fd);
+            }
+        }
+    }
+
+    return relations;
+}
+
+void stop_coordinator(Coordinator &coordinator)
+{
+    for (map<int, long>::const_iterator it = coordinator.workers.begin(); it != coordinator.workers.end(); ++it)
+    {
+        send_message(it->first, MSG_DONE, vector<unsigned char>());
+        close(it->first);
+    }
+    coordinator.workers.clear();
+    coordinator.worker_jobs.clear();
+
+    if (coordinator.listen_fd >= 0)
+    {
+        close(coordinator.listen_fd);
+        coordinator.listen_fd = -1;
+    }
+}
+
+// What a worker sieves, as sent in MSG_JOB
+struct WorkerJob
+{
+    mpz_class N;
+    uint64_t sieve_interval, seed;
+    double threshold_slack;
+    FactorBase factor_base;
+};
+
+static bool read_job(const vector<unsigned char> &payload, WorkerJob &job)
+{
+    ByteReader reader = {payload.empty() ? NULL : &payload[0], payload.empty() ? NULL : &payload[0] + payload.size()};
+    uint64_t B, multiplier;
+    if (!reader.mpz(job.N) || !reader.u64(B) || !reader.u64(multiplier) || !reader.u64(job.sieve_interval) ||
+        !reader.u64(job.seed) || !reader.f64(job.threshold_slack))
+        return false;
+
+    // The factor base is a function of kN, B and k only, so it matches the coordinator's
+    job.factor_base = generateFactorBase(B, job.N, multiplier);
+    if (verbose())
+        cout << "Worker: sieving for " << job.N << " with " << job.factor_base.size() << " primes." << endl;
+    return true;
+}
+
+int run_worker(const string &host, unsigned short port)
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses;
+    string port_str = to_string(port);
+    if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &addresses) != 0)
+    {
+        cerr << "Error: could not resolve " << host << endl;
+        return EXIT_FAILURE;
+    }
+
+    int fd = -1;
+    for (addrinfo *a = addresses; a != NULL && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0)
+    {
+        cerr << "Error: could not connect to " << host << ":" << port << endl;
+        return EXIT_FAILURE;
+    }
+
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    uint8_t type;
+    vector<unsigned char> payload;
+    WorkerJob job;
+    if (!receive_message(fd, type, payload) || type != MSG_JOB || !read_job(payload, job))
+    {
+        cerr << "Error: no job received from the coordinator." << endl;
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long units = 0;
+    while (send_message(fd, MSG_WANT, vector<unsigned char>()) && receive_message(fd, type, payload))
+    {
+        if (type == MSG_JOB)
+        { // The coordinator moved on to another part of the number
+            if (!read_job(payload, job))
+                break;
+            continue;
+        }
+        if (type != MSG_UNIT)
+            break;
+
+        uint64_t unit;
+        ByteReader reader = {payload.empty() ? NULL : &payload[0], payload.empty() ? NULL : &payload[0] + payload.size()};
+        if (!reader.u64(unit))
+            break;
+
+        vector<Relation> relations, partial_relations;
+        sieve_siqs_unit(job.N, job.factor_base, job.sieve_interval, job.seed, job.threshold_slack, unit, relations,
+                        partial_relations);
+
+        vector<unsigned char> message;
+        put_u64(message, unit);
+        put_u32(message, relations.size());
+        for (const Relation &rel : relations)
+            put_relation(message, rel);
+        put_u32(message, partial_relations.size());
+        for (const Relation &rel : partial_relations)
+            put_relation(message, rel);
+
+        if (!send_message(fd, MSG_RESULT, message))
+            break;
+        units++;
+    }
+
+    if (verbose())
+        cout << "Worker: done after " << units << " units." << endl;
+    close(fd);
+    return EXIT_SUCCESS;
+}
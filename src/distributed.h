@@ -0,0 +1,63 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <gmpxx.h>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "smooth_relations.h"
+#include "large_prime.h"
+#include "factors.h"
+#include "config.h"
+
+// Coordinator side of distributed sieving: workers connect over TCP, are told what to factor and are handed
+// out units (each one a SIQS coefficient a chosen with its own seed, see sieve_siqs_unit). The relations they
+// send back are deduplicated and the partial relations combined here. Workers stay connected between jobs, so
+// one coordinator serves every part a factorisation sieves
+struct Coordinator
+{
+    int listen_fd;
+    std::vector<unsigned char> job;           // kN, B, k, the sieve interval, seed and slack of the current job
+    unsigned long job_id;                     // counts the jobs set, so results of an earlier one can be told apart
+    std::map<int, long> workers;              // socket of each worker -> unit it is sieving (-1 if none)
+    std::map<int, unsigned long> worker_jobs; // socket of each worker -> job it was last sent
+    std::vector<unsigned long> requeued;      // units of workers that disconnected, handed out again first
+    unsigned long next_unit;                  // first unit never handed out
+    unsigned long units_done;                 // units whose results came back
+    std::set<mpz_class> seen;                 // x of every relation received, to drop duplicates
+    const std::atomic<bool> *cancel;          // stops collecting once set, or NULL
+    size_t extra_relations;                   // relations to collect beyond the size of the factor base
+
+    Coordinator()
+        : listen_fd(-1), job_id(0), next_unit(0), units_done(0), cancel(NULL), extra_relations(SIQS_EXTRA_RELATIONS) {}
+};
+
+// Listens for workers on the given TCP port
+bool start_coordinator(Coordinator &coordinator, unsigned short port);
+
+// Starts a new job: N is the number sieved, multiplier times the one being factored. Connected workers are sent
+// it the next time they ask for a unit, and whatever they were still sieving for the previous job is dropped
+void set_coordinator_job(Coordinator &coordinator,
+                         const mpz_class &N,
+                         unsigned long B,
+                         unsigned long multiplier,
+                         unsigned long sieve_interval,
+                         uint64_t seed,
+                         double threshold_slack);
+
+// Hands out units and collects relations from the workers until there are enough to run the linear algebra
+std::vector<Relation> collect_distributed_relations(Coordinator &coordinator,
+                                                    const mpz_class &N,
+                                                    const FactorBase &factor_base,
+                                                    std::vector<Relation> &existing_relations,
+                                                    PartialRelations &partials);
+
+// Tells the workers to stop and closes every socket
+void stop_coordinator(Coordinator &coordinator);
+
+// Worker process: connects to the coordinator and sieves the units of each job it is given until told to stop
+int run_worker(const std::string &host, unsigned short port);
+
+#endif // DISTRIBUTED_H
@@ -0,0 +1,741 @@
+#include "factorize.h"
+#include "verbose.h"
+#include "smoothness_bound.h"
+#include "factors.h"
+#include "smooth_relations.h"
+#include "siqs.h"
+#include "large_prime.h"
+#include "probable_prime.h"
+#include "linear.h"
+#include "lanczos.h"
+#include "filter.h"
+#include "checkpoint.h"
+#include "distributed.h"
+#include "parameters.h"
+#include "telemetry.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <omp.h>
+
+using namespace std;
+
+thread_local bool verbose_output = true;
+
+static double seconds_since(const chrono::steady_clock::time_point &start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Sets the number of threads used by the parallel loops started from this thread, restoring it afterwards
+struct ThreadCount
+{
+    int previous;
+
+    ThreadCount(int threads) : previous(0)
+    {
+#ifdef _OPENMP
+        previous = omp_get_max_threads();
+        if (threads > 0)
+            omp_set_num_threads(threads);
+#endif
+    }
+
+    ~ThreadCount()
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(previous);
+#endif
+    }
+};
+
+// Adds the phase times of one sieving run to the times of the whole factorisation
+static void add_times(PhaseTimes &total, const PhaseTimes &times)
+{
+    total.factor_base += times.factor_base;
+    total.sieving += times.sieving;
+    total.verification += times.verification;
+    total.linear_algebra += times.linear_algebra;
+    total.square_root += times.square_root;
+    total.relations += times.relations;
+    total.polynomials += times.polynomials;
+}
+
+// Adds the counters of one sieving run to those of the whole factorisation. The relations wanted are the ones
+// of the latest run, and n, the phase and the elapsed time are left to the caller
+static void add_telemetry(Telemetry &total, const Telemetry &run)
+{
+    add_times(total.times, run.times);
+    total.sieve.add(run.sieve);
+    total.relations_needed = run.relations_needed;
+    total.partial_relations += run.partial_relations;
+    total.combined_relations += run.combined_relations;
+    total.attempts += run.attempts;
+    total.dependencies += run.dependencies;
+    total.filter_seconds += run.filter_seconds;
+    total.lanczos_seconds += run.lanczos_seconds;
+    total.echelon_seconds += run.echelon_seconds;
+}
+
+// Writes the counters of the whole factorisation as done, once when factorize returns
+static void export_done(const Options &options, Telemetry &telemetry, const chrono::steady_clock::time_point &start)
+{
+    if (options.telemetry_file.empty())
+        return;
+    telemetry.phase = "done";
+    telemetry.elapsed = seconds_since(start);
+    if (!write_telemetry(options.telemetry_file, telemetry) && verbose())
+        cerr << "Could not write " << options.telemetry_file << endl;
+}
+
+// Replaces each part sharing a nontrivial factor with divisor by that factor and its cofactor.
+// Returns true if any part was split
+static bool split_parts(vector<mpz_class> &parts, const mpz_class &divisor)
+{
+    bool split = false;
+    size_t count = parts.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        mpz_class g = gcd(parts[i], divisor);
+        if (g != 1 && g != parts[i])
+        {
+            parts.push_back(parts[i] / g);
+            parts[i] = g;
+            split = true;
+        }
+    }
+    return split;
+}
+
+// Largest k with n = root^k, or 1 if n isn't a perfect power
+static unsigned int perfect_power(const mpz_class &n, mpz_class &root)
+{
+    if (!mpz_perfect_power_p(n.get_mpz_t()))
+        return 1;
+    for (unsigned long k = mpz_sizeinbase(n.get_mpz_t(), 2); k >= 2; k--)
+    {
+        if (mpz_root(root.get_mpz_t(), n.get_mpz_t(), k))
+            return k;
+    }
+    return 1;
+}
+
+// A nontrivial factor of n shared with one of the known divisors, if there is one
+static bool common_divisor(const mpz_class &n, const vector<mpz_class> &known, mpz_class &divisor)
+{
+    for (const mpz_class &k : known)
+    {
+        divisor = gcd(n, k);
+        if (divisor != 1 && divisor != n)
+            return true;
+    }
+    return false;
+}
+
+// Splits n (odd, composite and not a perfect power) by sieving kn. The dependencies of the successful linear
+// algebra attempt are tried until the parts are all probable primes or they run out. parts gets the pieces, at
+// least two of them, whose product is n. The counters of this run are added to total, which holds those of the
+// earlier runs and whose elapsed time is the time spent before this one. With a coordinator port set,
+// coordinator is started on the first call and given a new job on each later one
+static bool sieve_split(const mpz_class &n,
+                        const Options &options,
+                        gmp_randclass &rng,
+                        Coordinator &coordinator,
+                        Telemetry &total,
+                        vector<mpz_class> &parts,
+                        string &error)
+{
+    chrono::steady_clock::time_point call_start = chrono::steady_clock::now();
+
+    Telemetry telemetry; // this run only
+    PhaseTimes &times = telemetry.times;
+
+    // SIQS needs enough digits to build the polynomial coefficients out of the factor base
+    bool use_siqs = options.use_siqs && mpz_sizeinbase(n.get_mpz_t(), 10) >= SIQS_MIN_DIGITS;
+
+    chrono::steady_clock::time_point phase_start = chrono::steady_clock::now();
+
+    // Sieve kn rather than n, with k chosen so that more small primes divide the values x^2 - kn.
+    // Relations mod kn hold mod n too, so only the square root step works with n itself
+    unsigned long multiplier = options.multiplier ? options.multiplier : knuth_schroeppel(n);
+    if (mpz_gcd_ui(NULL, n.get_mpz_t(), multiplier) != 1)
+        multiplier = 1;
+    mpz_class kn = n * multiplier;
+    if (verbose())
+    {
+        cout << "Multiplier k: " << multiplier << endl;
+    }
+
+    // Parameters tuned by --autotune for numbers of this size, unless the options set them
+    unsigned long B = options.smoothness_bound;
+    unsigned long sieve_interval = options.sieve_interval;
+    double threshold_slack = options.threshold_slack;
+    size_t extra_relations = options.extra_relations;
+    vector<TunedParameters> table;
+    if (!options.parameter_file.empty() && load_parameter_table(options.parameter_file, table))
+    {
+        TunedParameters tuned = lookup_parameters(table, mpz_sizeinbase(n.get_mpz_t(), 10));
+        if (B == 0)
+            B = tuned.smoothness_bound;
+        if (sieve_interval == 0)
+            sieve_interval = tuned.sieve_interval;
+        if (threshold_slack == 0)
+            threshold_slack = tuned.threshold_slack;
+        if (extra_relations == 0)
+            extra_relations = tuned.extra_relations;
+        if (verbose())
+            cout << "Using the parameters tuned in " << options.parameter_file << endl;
+    }
+
+    // Otherwise the formulas and constants of config.h
+    if (B == 0)
+        B = smoothnessBound(kn, use_siqs);
+    if (sieve_interval == 0)
+        sieve_interval = use_siqs ? SIQS_SIEVE_INTERVAL : SIEVE_INTERVAL;
+    if (threshold_slack == 0)
+        threshold_slack = SIEVE_THRESHOLD_SLACK;
+    if (extra_relations == 0)
+        extra_relations = SIQS_EXTRA_RELATIONS;
+
+    if (verbose())
+    {
+        cout << "Smoothness bound B: " << B << endl;
+    }
+
+    // Generate the factor base
+    FactorBase factorBase = generateFactorBase(B, kn, multiplier);
+    vector<unsigned long> dividers = factorBase.dividers;
+    times.factor_base = seconds_since(phase_start);
+
+    if (dividers.size() > 0)
+    { // Primes below B with Legendre symbol 0 divide n, which splits it without sieving
+        if (verbose())
+        {
+            cout << "Found small prime factors: ";
+            for (unsigned long divider : dividers)
+            {
+                cout << divider << " ";
+            }
+            cout << endl;
+        }
+
+        parts.assign(1, n);
+        for (unsigned long divider : dividers)
+            split_parts(parts, mpz_class(divider));
+        add_telemetry(total, telemetry);
+        return true;
+    }
+
+    if (verbose())
+    {
+        cout << "Factor Base: ";
+        for (unsigned long prime : factorBase.primes)
+        {
+            cout << prime << " ";
+        }
+        cout << endl;
+    }
+
+    // ceil
+    mpz_class sqrt_n = isqrt(kn);
+
+    if (verbose())
+    {
+        cout << "Starting B-smooth search around x = " << sqrt_n << endl;
+    }
+
+    bool found_factor = false;
+    int attempt = 0;
+
+    // start searching for smooth relations at sqrt(kn)
+    vector<Relation> relations;
+    mpz_class start_x = sqrt_n;
+    initSieveOffsets(factorBase, start_x);
+    SiqsState siqs_state(options.seed);
+    SieveStats sieve_stats; // candidates checked when sieving x^2 - n
+    siqs_state.cancel = options.cancel;
+    siqs_state.threshold_slack = threshold_slack;
+    siqs_state.extra_relations = extra_relations;
+    PartialRelations partials;
+
+    // Counters of this run, added to those of the earlier runs and written to the telemetry file at most every
+    // telemetry_interval seconds while sieving, and always as each phase starts. The sieve counters only change
+    // between polynomials and attempts, which is where this is called from
+    chrono::steady_clock::time_point last_export = call_start;
+    auto update_telemetry = [&](size_t relation_count, size_t needed) {
+        telemetry.sieve = siqs_state.stats;
+        telemetry.sieve.add(sieve_stats);
+        times.relations = relation_count;
+        times.polynomials = siqs_state.polynomials;
+        telemetry.relations_needed = needed;
+        telemetry.partial_relations = partials.partial_count;
+        telemetry.combined_relations = partials.combined_count;
+    };
+    auto export_telemetry = [&](const char *phase, size_t relation_count, size_t needed, bool force) {
+        if (options.telemetry_file.empty() || (!force && seconds_since(last_export) < options.telemetry_interval))
+            return;
+        last_export = chrono::steady_clock::now();
+        update_telemetry(relation_count, needed);
+        Telemetry snapshot = total;
+        add_telemetry(snapshot, telemetry);
+        snapshot.phase = phase;
+        snapshot.elapsed = total.elapsed + seconds_since(call_start);
+        if (!write_telemetry(options.telemetry_file, snapshot) && verbose())
+            cerr << "Could not write " << options.telemetry_file << endl;
+    };
+
+    siqs_state.on_progress = [&](unsigned long polynomials, size_t relation_count, size_t target) {
+        if (options.progress)
+        {
+            Progress progress = {"sieving", relation_count, target, polynomials};
+            options.progress(progress);
+        }
+        export_telemetry("sieving", relation_count, target, false);
+    };
+    IncrementalMatrix echelon(factorBase.size() + 1);
+    bool lanczos_tried = false; // Block Lanczos runs once, later attempts extend the echelon form
+
+    // Hand the sieving out to worker processes (only SIQS polynomials are split into units)
+    bool distributed = false;
+    coordinator.cancel = options.cancel;
+    coordinator.extra_relations = extra_relations;
+    if (options.coordinator_port != 0)
+    {
+        if (!use_siqs)
+        {
+            cout << "Number too small for distributed sieving, sieving locally." << endl;
+        }
+        else if (coordinator.listen_fd < 0 && !start_coordinator(coordinator, options.coordinator_port))
+        {
+            error = "Could not start the coordinator.";
+            return false;
+        }
+        else
+        {
+            set_coordinator_job(coordinator, kn, B, multiplier, sieve_interval, options.seed, threshold_slack);
+            distributed = true;
+        }
+    }
+
+    // Pick up the relations of an interrupted run on the same number, and skip what it already sieved
+    RelationLog relation_log;
+    relation_log.progress.use_siqs = use_siqs;
+    relation_log.progress.sieve_interval = sieve_interval;
+    relation_log.progress.start_x = start_x;
+    bool checkpoints = options.checkpoints && !distributed;
+    if (checkpoints && open_relation_log(relation_log, options.checkpoint_file, kn, B, factorBase, sieve_interval,
+                                         options.seed, relations, partials))
+    {
+        use_siqs = relation_log.progress.use_siqs;
+        sieve_interval = relation_log.progress.sieve_interval;
+        start_x = relation_log.progress.start_x;
+        initSieveOffsets(factorBase, start_x);
+        siqs_state.resume_polynomials = relation_log.progress.polynomials;
+
+        if (verbose())
+        {
+            cout << "Resuming from " << options.checkpoint_file << " with " << relations.size() << " relations and "
+                 << partials.relations.size() << " partial relations";
+            if (use_siqs)
+                cout << " after " << relation_log.progress.polynomials << " polynomials";
+            cout << "." << endl;
+        }
+    }
+    if (checkpoints)
+        siqs_state.log = &relation_log;
+
+    export_telemetry("sieving", relations.size(), factorBase.size() + 1, true);
+
+    // while we haven't found a factor, keep searching by starting at a higher point and increasing the sieve interval
+    while (!found_factor)
+    {
+        if (options.cancel && *options.cancel)
+        {
+            error = "Cancelled.";
+            break;
+        }
+
+        attempt++;
+        if (verbose())
+        {
+            cout << "\nAttempt " << attempt << " with sieve interval: " << sieve_interval << endl;
+            if (use_siqs)
+                cout << "Continuing SIQS after " << siqs_state.polynomials << " polynomials" << endl;
+            else
+                cout << "Starting search at x = " << start_x << endl;
+            cout << "Current relations count: " << relations.size() << endl;
+        }
+
+        phase_start = chrono::steady_clock::now();
+        if (distributed)
+        {
+            relations = collect_distributed_relations(coordinator, kn, factorBase, relations, partials);
+        }
+        else if (use_siqs)
+        {
+            size_t previous_count = relations.size();
+            relations = find_smooth_relations_siqs(kn, factorBase, sieve_interval, relations, siqs_state, partials);
+
+            if (relations.size() == previous_count)
+            { // Ran out of polynomials, fall back to sieving x^2 - n
+                if (verbose())
+                    cout << "SIQS found no new relations, switching to x^2 - n." << endl;
+                use_siqs = false;
+                sieve_interval = SIEVE_INTERVAL;
+            }
+        }
+        else
+        {
+            relations = find_smooth_relations(kn, factorBase, sieve_interval, relations, start_x, partials,
+                                              threshold_slack, sieve_stats);
+        }
+        times.sieving += seconds_since(phase_start);
+        export_telemetry("sieving", relations.size(), factorBase.size() + 1, false);
+
+        if (checkpoints)
+        {
+            relation_log.progress.use_siqs = use_siqs;
+            relation_log.progress.polynomials = siqs_state.polynomials;
+            relation_log.progress.sieve_interval = sieve_interval;
+            relation_log.progress.start_x = start_x;
+            write_checkpoint(relation_log, relations, partials);
+        }
+
+        if (verbose())
+        {
+            cout << "Found " << relations.size() << " smooth relations so far ("
+                 << partials.combined_count << " combined from " << partials.partial_count << " partial relations)." << endl;
+
+            SieveStats stats = siqs_state.stats;
+            stats.add(sieve_stats);
+            print_sieve_stats(stats);
+        }
+
+        // Sieving stops early when cancelled, don't spend time on the linear algebra then
+        if (options.cancel && *options.cancel)
+            continue;
+
+        // Check if we have enough relations to try finding dependencies (need at least pi(B))
+        if (relations.size() > factorBase.size())
+        {
+            if (options.progress)
+            {
+                Progress progress = {"linear algebra", relations.size(), factorBase.size() + 1, siqs_state.polynomials};
+                options.progress(progress);
+            }
+            export_telemetry("linear algebra", relations.size(), factorBase.size() + 1, true);
+
+            phase_start = chrono::steady_clock::now();
+            chrono::steady_clock::time_point step_start = phase_start;
+            vector<Relation> filtered;
+            vector<vector<int>> dependencies;
+            bool have_dependencies = false;
+            telemetry.attempts++;
+
+            // Block Lanczos works on the sparse matrix and scales much better for large relation sets,
+            // shrink the matrix first with each filtered relation a product of collected ones. Its 64 or so
+            // dependencies nearly always split n, so it only runs once: if they all fail, rerunning it on every
+            // attempt would redo the whole matrix, so the next attempt eliminates everything into the echelon
+            // form once and the ones after that only the new relations
+            if (!lanczos_tried && relations.size() >= options.lanczos_min_relations)
+            {
+                lanczos_tried = true;
+                filtered = options.filtering ? filter_relations(relations, kn) : relations;
+                telemetry.filter_seconds += lap_seconds(step_start);
+                have_dependencies = block_lanczos(filtered, dependencies);
+                telemetry.lanczos_seconds += lap_seconds(step_start);
+                if (!have_dependencies)
+                    if (verbose())
+                        cout << "Block Lanczos failed, falling back to Gaussian elimination." << endl;
+            }
+
+            // Otherwise only the relations found since the last attempt are eliminated, against the pivots kept
+            // from earlier attempts, so any dependency returned here hasn't been tried yet
+            bool use_echelon = !have_dependencies;
+            if (use_echelon)
+            {
+                have_dependencies = add_relations(echelon, relations, dependencies);
+                telemetry.echelon_seconds += lap_seconds(step_start);
+            }
+            const vector<Relation> &matrix_relations = use_echelon ? relations : filtered;
+            times.linear_algebra += seconds_since(phase_start);
+            telemetry.dependencies += dependencies.size();
+
+            if (!have_dependencies)
+            {
+                if (verbose())
+                    cout << "No nontrivial dependency found; need more relations." << endl;
+                // We don't need to increase the sieve interval, just continue collecting more relations
+                continue;
+            }
+
+            if (verbose())
+                cout << "\nFound " << dependencies.size() << " dependency vector(s)." << endl;
+
+            // Every dependency gives a divisor of n, so they are tried until n is split into probable primes
+            // (a single one is enough for two factors, more are needed when n has three or more)
+            export_telemetry("square root", relations.size(), factorBase.size() + 1, true);
+            phase_start = chrono::steady_clock::now();
+            parts.assign(1, n);
+            bool found = false;
+            for (size_t k = 0; k < dependencies.size(); k++)
+            {
+                mpz_class factor = solve_dependency(matrix_relations, dependencies[k], factorBase, n);
+                if (factor == 1 || factor == n || !split_parts(parts, factor))
+                    continue;
+
+                found = true;
+                found_factor = true;
+                if (verbose())
+                    cout << "\nDependency vector " << k << " produced a nontrivial factor." << endl;
+
+                bool all_prime = true;
+                for (const mpz_class &part : parts)
+                    all_prime = all_prime && isProbablePrime(part, MAX_ITERATIONS, rng);
+                if (all_prime)
+                    break;
+            }
+            times.square_root += seconds_since(phase_start);
+
+            if (!found)
+            {
+                if (verbose())
+                    cout << "\nNone of the dependency vectors produced a nontrivial factor." << endl;
+                // Continue collecting more relations - no need to increase interval
+            }
+        }
+        else
+        {
+            // If we don't have enough relations yet, continue collecting more
+            if (verbose())
+                cout << "Need more relations. Currently have " << relations.size()
+                     << " of " << (factorBase.size() + 1) << " required." << endl;
+        }
+
+        // Increase the sieve interval after several attempts with no new relations (don't exceed MAX_SIEVE_INTERVAL as program may take too long)
+        if (!use_siqs && attempt % 5 == 0 && relations.size() < factorBase.size() / 2 && sieve_interval < MAX_SIEVE_INTERVAL)
+        {
+            sieve_interval *= 10;
+            if (verbose())
+                cout << "Increasing sieve interval to " << sieve_interval << endl;
+        }
+    }
+
+    // The relation file is only needed until the factorisation succeeds
+    close_relation_log(relation_log, found_factor);
+
+    SieveStats stats = siqs_state.stats;
+    stats.add(sieve_stats);
+    update_telemetry(relations.size(), factorBase.size() + 1);
+    times.verification = stats.resieve_seconds + stats.trial_seconds;
+    times.total = seconds_since(call_start);
+    add_telemetry(total, telemetry);
+
+    if (!found_factor)
+    {
+        if (error.empty())
+            error = "Failed to find nontrivial factor after " + to_string(attempt) + " attempts.";
+        return false;
+    }
+
+    return true;
+}
+
+bool factorize(mpz_class n, Factorization &factorization, const Options &options, string &error)
+{
+    verbose_output = options.verbose;
+    ThreadCount thread_count(options.threads);
+
+    chrono::steady_clock::time_point call_start = chrono::steady_clock::now();
+
+    // Counters of every sieving run of this call, written to the telemetry file as they go
+    Telemetry telemetry;
+    PhaseTimes &times = telemetry.times;
+    telemetry.n = n.get_str();
+    telemetry.digits = mpz_sizeinbase(n.get_mpz_t(), 10);
+#ifdef _OPENMP
+    telemetry.threads = omp_get_max_threads();
+#endif
+    if (options.timings)
+        *options.timings = times;
+
+    factorization.clear();
+    if (n < 2)
+    {
+        error = "Enter a number greater than 1.";
+        return false;
+    }
+
+    // Random state of this call only, so concurrent calls don't share it
+    gmp_randclass rng(gmp_randinit_default);
+    rng.seed(options.seed);
+
+    // use sieve of Eratosthenes to find small prime factors up till log(n)
+
+    double n_d = n.get_d(); // we can use double as we don't need precision here as log can be approximate
+    unsigned long limit = static_cast<unsigned long>(ceil(log(n_d)));
+    if (verbose())
+    {
+        cout << "Finding factors up to log(n) = " << limit << " using brute force" << endl;
+    }
+
+    // actual sieve
+    vector<bool> is_prime(limit + 1, true);
+    if (limit >= 0)
+    {
+        is_prime[0] = is_prime[1] = false;
+    }
+
+    for (unsigned long i = 2; i * i <= limit; ++i)
+    {
+        if (is_prime[i])
+        {
+            for (unsigned long j = i * i; j <= limit; j += i)
+            {
+                is_prime[j] = false;
+            }
+        }
+    }
+
+    vector<unsigned long> primes;
+    for (unsigned long i = 2; i <= limit; ++i)
+    {
+        if (is_prime[i])
+        {
+            primes.push_back(i);
+        }
+    }
+
+    // Remove small prime factors
+    for (unsigned long p : primes)
+    {
+        while (n % p == 0)
+        { // keep dividing n by p until it is no longer divisible
+            mpz_class prime_factor(p);
+            if (factorization.find(prime_factor) == factorization.end())
+            {
+                if (verbose())
+                {
+                    cout << "Removed factor: " << p << endl;
+                }
+            }
+            factorization[prime_factor]++;
+            n /= p;
+        }
+    }
+
+    if (n != 1 && verbose())
+    {
+        cout << "Remaining number after removing small factors: " << n << endl;
+    }
+
+    // Miller-Rabin strong probable prime test: if n is prime, do not proceed
+    if (EXIT_ON_MILLER_RABIN_FAIL && factorization.empty() && isProbablePrime(n, MAX_ITERATIONS, rng))
+    {
+        error = "The number is prime. Enter a composite number.";
+        return false;
+    }
+
+    // Parts of n left to factor, each with the power it divides n with. A part is done if it is prime, taken
+    // to its root if it is a perfect power, split with the divisors already found if they share a factor, and
+    // only sieved when none of that works. Sieving often splits n completely, since every dependency gives
+    // a divisor, and a part it leaves composite is sieved on its own
+    vector<pair<mpz_class, unsigned int>> pending;
+    vector<mpz_class> known; // parts found so far
+    Coordinator coordinator; // workers stay connected from one sieved part to the next
+    if (n != 1)
+        pending.push_back(make_pair(n, 1u));
+
+    while (!pending.empty())
+    {
+        mpz_class part = pending.back().first;
+        unsigned int power = pending.back().second;
+        pending.pop_back();
+
+        if (isProbablePrime(part, MAX_ITERATIONS, rng))
+        {
+            factorization[part] += power;
+            known.push_back(part);
+            continue;
+        }
+
+        mpz_class root;
+        unsigned int k = perfect_power(part, root);
+        if (k > 1)
+        {
+            if (verbose())
+                cout << "Perfect power found: " << root << "^" << k << endl;
+            pending.push_back(make_pair(root, power * k));
+            continue;
+        }
+
+        mpz_class divisor;
+        if (common_divisor(part, known, divisor))
+        {
+            pending.push_back(make_pair(divisor, power));
+            pending.push_back(make_pair(mpz_class(part / divisor), power));
+            continue;
+        }
+
+        if (verbose() && part != n)
+            cout << "\nSieving the composite factor " << part << endl;
+
+        vector<mpz_class> parts;
+        telemetry.elapsed = seconds_since(call_start);
+        if (!sieve_split(part, options, rng, coordinator, telemetry, parts, error))
+        {
+            stop_coordinator(coordinator);
+            times.total = seconds_since(call_start);
+            export_done(options, telemetry, call_start);
+            if (options.timings)
+                *options.timings = times;
+            return false;
+        }
+        for (const mpz_class &p : parts)
+        {
+            pending.push_back(make_pair(p, power));
+            known.push_back(p);
+        }
+    }
+
+    stop_coordinator(coordinator);
+    times.total = seconds_since(call_start);
+    export_done(options, telemetry, call_start);
+    if (options.timings)
+        *options.timings = times;
+    return true;
+}
+
+string format_factorization(const Factorization &factorization, const string &separator)
+{
+    string result;
+    for (Factorization::const_iterator it = factorization.begin(); it != factorization.end(); ++it)
+    {
+        if (it != factorization.begin())
+            result += separator;
+        result += it->first.get_str();
+        if (it->second > 1)
+            result += "^" + to_string(it->second);
+    }
+    return result;
+}
+
+vector<mpz_class> factor(const mpz_class &n, const Options &options)
+{
+    // A prime is its own factorisation, which factorize reports as an error
+    gmp_randclass rng(gmp_randinit_default);
+    rng.seed(options.seed);
+    if (isProbablePrime(n, MAX_ITERATIONS, rng))
+        return vector<mpz_class>(1, n);
+
+    Factorization factorization;
+    string error;
+    if (!factorize(n, factorization, options, error))
+        return vector<mpz_class>();
+
+    vector<mpz_class> factors;
+    for (const pair<const mpz_class, unsigned int> &f : factorization)
+        factors.insert(factors.end(), f.second, f.first);
+    return factors;
+}
@@ -0,0 +1,92 @@
+#ifndef FACTORIZE_H
+#define FACTORIZE_H
+
+#include <gmpxx.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "config.h"
+
+// Where a factorisation has got to, passed to the progress callback
+struct Progress
+{
+    const char *phase;         // "sieving" or "linear algebra"
+    size_t relations;          // full relations collected so far
+    size_t relations_needed;   // relations wanted before the next linear algebra attempt
+    unsigned long polynomials; // SIQS polynomials sieved so far
+};
+
+// Wall time of each phase of a factorisation in seconds. Verification (resieving and trial division of the
+// sieve candidates) is part of sieving and is summed over the sieving threads
+struct PhaseTimes
+{
+    double factor_base;        // multiplier choice and factor base
+    double sieving;            // collecting relations, over every attempt
+    double verification;       // checking sieve candidates, thread seconds
+    double linear_algebra;     // filtering and finding dependencies
+    double square_root;        // square roots and gcds of the dependencies
+    double total;              // the whole call
+    size_t relations;          // full relations collected
+    unsigned long polynomials; // SIQS polynomials sieved
+
+    PhaseTimes()
+        : factor_base(0), sieving(0), verification(0), linear_algebra(0), square_root(0), total(0), relations(0),
+          polynomials(0) {}
+};
+
+// How a single factorisation is run. The defaults come from config.h; everything here is per call,
+// so several factorisations can run in one process at the same time
+struct Options
+{
+    unsigned long smoothness_bound; // factor base bound B (0 for the parameter table or a formula in the size of n)
+    unsigned long sieve_interval;   // sieve interval (0 for the table, SIQS_SIEVE_INTERVAL or SIEVE_INTERVAL)
+    double threshold_slack;         // sieve threshold slack (0 for the table or SIEVE_THRESHOLD_SLACK)
+    size_t extra_relations;         // relations beyond the factor base size (0 for the table or SIQS_EXTRA_RELATIONS)
+    std::string parameter_file;     // table written by --autotune for the values left at 0 ("" to use config.h)
+    unsigned long multiplier;       // sieve k * n with this k (0 to choose it with Knuth-Schroeppel, 1 to sieve n)
+    bool use_siqs;                  // sieve SIQS polynomials when n has at least SIQS_MIN_DIGITS digits
+    bool filtering;                 // filter the relations before Block Lanczos
+    size_t lanczos_min_relations;   // number of relations from which Block Lanczos replaces Gaussian elimination
+    int threads;                    // threads for the parallel loops (0 for the OpenMP default)
+    uint64_t seed;                  // seed of this call's random state (SIQS coefficients, Miller-Rabin bases)
+
+    const std::atomic<bool> *cancel;                // stops the factorisation once set (may be NULL)
+    std::function<void(const Progress &)> progress; // called as relations are collected (may be empty)
+    PhaseTimes *timings;                            // filled in with the time spent in each phase (may be NULL)
+    std::string telemetry_file;                     // counters written here while running and at the end ("" for none)
+    double telemetry_interval;                      // seconds between writes of telemetry_file
+
+    bool verbose;                    // progress output on stdout (only if VERBOSE is set)
+    bool checkpoints;                // stream relations to checkpoint_file and resume from it (off by default)
+    std::string checkpoint_file;     // relation file, must differ between calls running at the same time
+    unsigned short coordinator_port; // hand the sieving out to workers on this port (0 to sieve locally)
+
+    Options()
+        : smoothness_bound(0), sieve_interval(0), threshold_slack(0), extra_relations(0),
+          parameter_file(PARAMETER_FILE), multiplier(USE_MULTIPLIER ? 0 : 1), use_siqs(USE_SIQS), filtering(USE_FILTERING),
+          lanczos_min_relations(LANCZOS_MIN_RELATIONS), threads(0), seed(SIQS_SEED), cancel(NULL),
+          timings(NULL), telemetry_file(TELEMETRY_FILE), telemetry_interval(TELEMETRY_INTERVAL), verbose(true), checkpoints(false), checkpoint_file(CHECKPOINT_FILE),
+          coordinator_port(0) {}
+};
+
+// Prime factors of a number, each with the power it divides the number with
+typedef std::map<mpz_class, unsigned int> Factorization;
+
+// Factors n completely: small factors by trial division, then each composite part is taken to its root if it is
+// a perfect power, split with the factors already found, or sieved. The divisors given by all the dependencies
+// of one sieving run are used, so a number with several large factors is usually split by a single run.
+// Returns false with the reason in error if n is prime, a part could not be split or it was cancelled
+bool factorize(mpz_class n, Factorization &factorization, const Options &options, std::string &error);
+
+// The factors in increasing order as p or p^e, separated by separator
+std::string format_factorization(const Factorization &factorization, const std::string &separator);
+
+// Library entry point: the prime factors of n in increasing order, each repeated as often as it divides n
+// (n itself if it is prime), or nothing if the factorisation failed or was cancelled. Safe to call from several
+// threads at once
+std::vector<mpz_class> factor(const mpz_class &n, const Options &options = Options());
+
+#endif // FACTORIZE_H
@@ -1,53 +1,230 @@
 #include "factors.h"
+#include "smooth_relations.h"
+#include "sieve.h"
+#include "config.h"
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
 
-std::pair<std::vector<unsigned long>, std::vector<unsigned long>> generateFactorBase(unsigned long B, const mpz_class &n)
+// Legendre symbol (a/p) for an odd prime p, using quadratic reciprocity on native integers
+static int legendre_ui(unsigned long a, unsigned long p)
 {
-    // Initally mark all numbers from 0 to B as prime
-    std::vector<bool> is_prime(B + 1, true);
-    is_prime[0] = is_prime[1] = false;
+    unsigned long n = p;
+    int result = 1;
+    a %= n;
+    while (a != 0)
+    {
+        while (a % 2 == 0)
+        { // (2/n) = -1 when n = 3, 5 mod 8
+            a /= 2;
+            unsigned long r = n % 8;
+            if (r == 3 || r == 5)
+                result = -result;
+        }
+        std::swap(a, n);
+        if (a % 4 == 3 && n % 4 == 3)
+            result = -result;
+        a %= n;
+    }
+    return n == 1 ? result : 0;
+}
+
+unsigned long knuth_schroeppel(const mpz_class &n)
+{
+    std::vector<bool> is_prime(MULTIPLIER_PRIMES + 1, true);
+    std::vector<unsigned long> primes;
+    for (unsigned long i = 2; i <= MULTIPLIER_PRIMES; i++)
+    {
+        if (!is_prime[i])
+            continue;
+        primes.push_back(i);
+        for (unsigned long j = i * i; j <= MULTIPLIER_PRIMES; j += i)
+            is_prime[j] = false;
+    }
 
-    // Sieve of Eratosthenes to find all primes up to B
-    for (unsigned long i = 2; i * i <= B; ++i)
+    unsigned long best_k = 1;
+    double best_score = 0;
+    for (unsigned long k = 1; k <= MAX_MULTIPLIER; k++)
+    {
+        // Only square-free k coprime to n, so kn has no repeated small factors
+        bool square_free = true;
+        for (unsigned long p = 2; p * p <= k; p++)
+        {
+            if (k % (p * p) == 0)
+                square_free = false;
+        }
+        if (!square_free || mpz_gcd_ui(NULL, n.get_mpz_t(), k) != 1)
+            continue;
+
+        mpz_class kn = n * k;
+        double score = -0.5 * log(static_cast<double>(k));
+
+        // 2 divides x^2 - kn once, twice or three times on average depending on kn mod 8
+        unsigned long r = mpz_fdiv_ui(kn.get_mpz_t(), 8);
+        if (k % 2 == 0)
+            score += 0.5 * log(2.0);
+        else if (r == 1)
+            score += 2 * log(2.0);
+        else if (r == 5)
+            score += log(2.0);
+        else
+            score += 0.5 * log(2.0);
+
+        // An odd prime with two roots divides a value with probability 2 / p, and a prime dividing k with 1 / p,
+        // counting the powers of p that gives 2 log(p) / (p - 1) and log(p) / p
+        for (size_t i = 1; i < primes.size(); i++)
+        {
+            unsigned long p = primes[i];
+            if (k % p == 0)
+                score += log(static_cast<double>(p)) / p;
+            else if (legendre_ui(mpz_fdiv_ui(kn.get_mpz_t(), p), p) == 1)
+                score += 2 * log(static_cast<double>(p)) / (p - 1);
+        }
+
+        if (score > best_score || k == 1)
+        {
+            best_score = score;
+            best_k = k;
+        }
+    }
+    return best_k;
+}
+
+FactorBase generateFactorBase(unsigned long B, const mpz_class &n, unsigned long multiplier)
+{
+    // Sieve of Eratosthenes for the primes up to sqrt(B), used to sieve each segment
+    unsigned long root_B = static_cast<unsigned long>(sqrt(static_cast<double>(B))) + 1;
+    std::vector<bool> is_prime(root_B + 1, true);
+    is_prime[0] = is_prime[1] = false;
+    for (unsigned long i = 2; i * i <= root_B; ++i)
     {
         if (is_prime[i])
         {
-            for (unsigned long j = i * i; j <= B; j += i)
+            for (unsigned long j = i * i; j <= root_B; j += i)
             {
                 is_prime[j] = false;
             }
         }
     }
 
-    std::vector<unsigned long> factor_base;
-    std::vector<unsigned long> dividers;
-
-    if (B >= 2)
+    std::vector<unsigned long> small_primes;
+    for (unsigned long i = 3; i <= root_B; i += 2)
     {
-        factor_base.push_back(2);
+        if (is_prime[i])
+        {
+            small_primes.push_back(i);
+        }
     }
 
-    // Iterate through odd primes
-    for (unsigned long i = 3; i <= B; i += 2)
+    // Segmented sieve of [0, B], each segment also checks which of its primes belong in the factor base
+    unsigned long num_segments = B / PRIME_SIEVE_SEGMENT + 1;
+    std::vector<std::vector<unsigned long>> segment_primes(num_segments);
+    std::vector<std::vector<unsigned long>> segment_residues(num_segments);
+    std::vector<std::vector<unsigned long>> segment_dividers(num_segments);
+
+#pragma omp parallel for schedule(dynamic)
+    for (unsigned long s = 0; s < num_segments; s++)
     {
-        if (is_prime[i])
+        unsigned long lo = s * PRIME_SIEVE_SEGMENT;
+        unsigned long hi = std::min(lo + PRIME_SIEVE_SEGMENT, B + 1);
+        std::vector<bool> composite(hi - lo, false);
+
+        for (unsigned long p : small_primes)
+        {
+            if (p * p >= hi)
+                break;
+            unsigned long first = std::max(p * p, ((lo + p - 1) / p) * p);
+            for (unsigned long j = first; j < hi; j += p)
+            {
+                composite[j - lo] = true;
+            }
+        }
+
+        // Iterate through odd primes
+        for (unsigned long i = std::max(lo | 1, 3UL); i < hi; i += 2)
         {
-            // Check if n is a quadratic residue modulo p
-            // Legendre symbol (n/p) = n^(p-1)/2 mod p
-            mpz_class legendre_symbol = mpz_legendre(n.get_mpz_t(), mpz_class(i).get_mpz_t());
+            if (composite[i - lo])
+                continue;
 
-            if (legendre_symbol == 0)
+            // Check if n is a quadratic residue modulo p, with a single reduction of n
+            unsigned long r = mpz_fdiv_ui(n.get_mpz_t(), i);
+            if (r == 0 && multiplier % i == 0)
+            { // p divides the multiplier, not the number being factored: x^2 = kn mod p has the root 0
+                segment_primes[s].push_back(i);
+                segment_residues[s].push_back(0);
+            }
+            else if (r == 0)
             {
-                if (mpz_divisible_ui_p(n.get_mpz_t(), i))
-                {
-                    dividers.push_back(i);
-                }
+                segment_dividers[s].push_back(i);
             }
-            else if (legendre_symbol == 1)
+            else if (legendre_ui(r, i) == 1)
             {
-                factor_base.push_back(i);
+                segment_primes[s].push_back(i);
+                segment_residues[s].push_back(r);
             }
         }
     }
 
-    return {factor_base, dividers};
+    FactorBase factor_base;
+
+    if (B >= 2)
+    {
+        factor_base.primes.push_back(2);
+        factor_base.n_mod_p.push_back(mpz_fdiv_ui(n.get_mpz_t(), 2));
+    }
+
+    for (unsigned long s = 0; s < num_segments; s++)
+    {
+        factor_base.primes.insert(factor_base.primes.end(), segment_primes[s].begin(), segment_primes[s].end());
+        factor_base.n_mod_p.insert(factor_base.n_mod_p.end(), segment_residues[s].begin(), segment_residues[s].end());
+        factor_base.dividers.insert(factor_base.dividers.end(), segment_dividers[s].begin(), segment_dividers[s].end());
+    }
+
+    // Square roots of n and logs, computed once per n
+    size_t size = factor_base.size();
+    factor_base.root1.assign(size, 0);
+    factor_base.root2.assign(size, 0);
+    factor_base.logs.assign(size, 0);
+    factor_base.offset1.assign(size, 0);
+    factor_base.offset2.assign(size, 0);
+
+#pragma omp parallel for
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned long p = factor_base.primes[i];
+        std::vector<unsigned long> sols;
+        if (factor_base.n_mod_p[i] != 0)
+            sols = tonelli_shanks(factor_base.n_mod_p[i], p);
+        factor_base.root1[i] = sols.empty() ? 0 : sols[0];
+        factor_base.root2[i] = sols.size() > 1 ? sols[1] : factor_base.root1[i];
+        factor_base.logs[i] = scaled_log2(p);
+    }
+
+    return factor_base;
+}
+
+void initSieveOffsets(FactorBase &factor_base, const mpz_class &start_x)
+{
+#pragma omp parallel for
+    for (size_t i = 0; i < factor_base.size(); i++)
+    {
+        unsigned long p = factor_base.primes[i];
+        unsigned long start_x_mod = mpz_fdiv_ui(start_x.get_mpz_t(), p);
+        unsigned long r1 = factor_base.root1[i];
+        unsigned long r2 = factor_base.root2[i];
+        factor_base.offset1[i] = (r1 >= start_x_mod) ? (r1 - start_x_mod) : (p - (start_x_mod - r1));
+        factor_base.offset2[i] = (r2 >= start_x_mod) ? (r2 - start_x_mod) : (p - (start_x_mod - r2));
+    }
+}
+
+void advanceSieveOffsets(FactorBase &factor_base, unsigned long sieve_interval)
+{
+#pragma omp parallel for
+    for (size_t i = 0; i < factor_base.size(); i++)
+    {
+        unsigned long p = factor_base.primes[i];
+        unsigned long shift = sieve_interval % p;
+        factor_base.offset1[i] = (factor_base.offset1[i] + p - shift) % p;
+        factor_base.offset2[i] = (factor_base.offset2[i] + p - shift) % p;
+    }
 }
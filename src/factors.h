@@ -4,7 +4,34 @@
 #include <vector>
 #include <gmpxx.h>
 
-// Generates the primes from 2 to B for which n is a quadratic residue modulo p
-std::pair<std::vector<unsigned long>, std::vector<unsigned long>> generateFactorBase(unsigned long B, const mpz_class &n);
+// Factor base built once per n, stored as a structure of arrays indexed by prime
+struct FactorBase
+{
+    std::vector<unsigned long> primes;   // primes p <= B for which n is a quadratic residue modulo p
+    std::vector<unsigned long> n_mod_p;  // n mod p
+    std::vector<unsigned long> root1;    // t with t^2 = n mod p
+    std::vector<unsigned long> root2;    // p - t (equal to t for p = 2)
+    std::vector<unsigned char> logs;     // scaled log2(p) used by the sieve
+    std::vector<unsigned long> offset1;  // next sieve position of x = root1 mod p when sieving x^2 - n
+    std::vector<unsigned long> offset2;  // next sieve position of x = root2 mod p when sieving x^2 - n
+    std::vector<unsigned long> dividers; // primes p <= B dividing n
+
+    size_t size() const { return primes.size(); }
+};
+
+// Generates the primes from 2 to B for which n is a quadratic residue modulo p,
+// along with their square roots of n and logs. When n is k times the number being factored,
+// the primes dividing the multiplier k are kept too, with the single root 0
+FactorBase generateFactorBase(unsigned long B, const mpz_class &n, unsigned long multiplier = 1);
+
+// Square-free multiplier k <= MAX_MULTIPLIER, coprime to n, maximising the Knuth-Schroeppel function,
+// i.e. the expected contribution of the small primes to the values x^2 - kn, less half of log k
+unsigned long knuth_schroeppel(const mpz_class &n);
+
+// Sets the sieve offsets so that position 0 of the next interval is x = start_x
+void initSieveOffsets(FactorBase &factor_base, const mpz_class &start_x);
+
+// Moves the sieve offsets forward by one interval of the given length
+void advanceSieveOffsets(FactorBase &factor_base, unsigned long sieve_interval);
 
 #endif // FACTORS_H
@@ -0,0 +1,207 @@
+#include "filter.h"
+#include "config.h"
+#include "verbose.h"
+#include <set>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+// Sorted symmetric difference, i.e. the sum mod 2 of two sparse vectors
+template <typename T>
+static vector<T> sum_mod2(const vector<T> &a, const vector<T> &b)
+{
+    vector<T> result;
+    set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(result));
+    return result;
+}
+
+// Number of live relations using each column
+static vector<size_t> column_weights(const vector<vector<unsigned int>> &cols, const vector<bool> &alive, size_t ncols)
+{
+    vector<size_t> weight(ncols, 0);
+    for (size_t i = 0; i < cols.size(); i++)
+    {
+        if (!alive[i])
+            continue;
+        for (unsigned int c : cols[i])
+            weight[c]++;
+    }
+    return weight;
+}
+
+// A relation using a column nobody else uses can't be part of a dependency
+static size_t remove_singletons(const vector<vector<unsigned int>> &cols, vector<bool> &alive, size_t ncols)
+{
+    size_t removed = 0;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        vector<size_t> weight = column_weights(cols, alive, ncols);
+        for (size_t i = 0; i < cols.size(); i++)
+        {
+            if (!alive[i])
+                continue;
+            for (unsigned int c : cols[i])
+            {
+                if (weight[c] == 1)
+                {
+                    alive[i] = false;
+                    removed++;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return removed;
+}
+
+// Drops the heaviest relations beyond FILTER_MAX_EXCESS more relations than used columns
+static size_t remove_excess(const vector<vector<unsigned int>> &cols, vector<bool> &alive, size_t ncols)
+{
+    if (FILTER_MAX_EXCESS == 0)
+        return 0;
+
+    vector<size_t> weight = column_weights(cols, alive, ncols);
+    size_t active_cols = 0;
+    for (size_t w : weight)
+        active_cols += (w > 0);
+
+    vector<pair<size_t, size_t>> by_weight; // (relation weight, relation)
+    for (size_t i = 0; i < cols.size(); i++)
+    {
+        if (alive[i])
+            by_weight.push_back(make_pair(cols[i].size(), i));
+    }
+
+    if (by_weight.size() <= active_cols + FILTER_MAX_EXCESS)
+        return 0;
+
+    size_t excess = by_weight.size() - active_cols - FILTER_MAX_EXCESS;
+    sort(by_weight.rbegin(), by_weight.rend());
+    for (size_t k = 0; k < excess; k++)
+        alive[by_weight[k].second] = false;
+
+    return excess;
+}
+
+// Structured Gaussian elimination: for a column used by few relations, add the lightest of them to the others
+// and drop it, which removes the column at the cost of one relation
+static size_t merge_columns(vector<vector<unsigned int>> &cols,
+                            vector<vector<size_t>> &groups,
+                            vector<bool> &alive,
+                            size_t ncols)
+{
+    vector<vector<size_t>> users(ncols);
+    for (size_t i = 0; i < cols.size(); i++)
+    {
+        if (!alive[i])
+            continue;
+        for (unsigned int c : cols[i])
+            users[c].push_back(i);
+    }
+
+    // Each relation is changed at most once per pass so the user lists stay valid
+    vector<bool> touched(cols.size(), false);
+    size_t merged = 0;
+
+    for (size_t c = 0; c < ncols; c++)
+    {
+        const vector<size_t> &rels = users[c];
+        if (rels.size() < 2 || rels.size() > FILTER_MERGE_MAX_WEIGHT)
+            continue;
+
+        bool free = true;
+        for (size_t r : rels)
+            free = free && !touched[r];
+        if (!free)
+            continue;
+
+        size_t pivot = rels[0];
+        for (size_t r : rels)
+        {
+            if (cols[r].size() < cols[pivot].size())
+                pivot = r;
+        }
+
+        for (size_t r : rels)
+        {
+            touched[r] = true;
+            if (r == pivot)
+                continue;
+            cols[r] = sum_mod2(cols[r], cols[pivot]);
+            groups[r] = sum_mod2(groups[r], groups[pivot]);
+        }
+        alive[pivot] = false;
+        merged++;
+    }
+    return merged;
+}
+
+vector<Relation> filter_relations(const vector<Relation> &relations, const mpz_class &N)
+{
+    size_t m = relations.size();
+    if (m == 0)
+        return relations;
+    size_t ncols = relation_columns(relations);
+
+    vector<vector<unsigned int>> cols(m);
+    vector<vector<size_t>> groups(m);
+    vector<bool> alive(m, true);
+
+    // Duplicates (the same x found twice) only give trivial dependencies
+    size_t duplicates = 0;
+    set<mpz_class> seen;
+    for (size_t i = 0; i < m; i++)
+    {
+        if (!seen.insert(relations[i].x).second)
+        {
+            alive[i] = false;
+            duplicates++;
+            continue;
+        }
+
+        cols[i] = odd_columns(relations[i]);
+        groups[i].push_back(i);
+    }
+
+    vector<size_t> weight = column_weights(cols, alive, ncols);
+    size_t cols_before = ncols - count(weight.begin(), weight.end(), 0);
+
+    size_t singletons = 0, excess = 0, merges = 0;
+    for (bool changed = true; changed;)
+    {
+        size_t removed = remove_singletons(cols, alive, ncols);
+        size_t dropped = remove_excess(cols, alive, ncols);
+        size_t merged = merge_columns(cols, groups, alive, ncols);
+        singletons += removed;
+        excess += dropped;
+        merges += merged;
+        changed = removed > 0 || dropped > 0 || merged > 0;
+    }
+
+    // Multiply out the original relations making up each remaining one
+    vector<Relation> filtered;
+    for (size_t i = 0; i < m; i++)
+    {
+        if (!alive[i])
+            continue;
+
+        Relation rel = relations[groups[i][0]];
+        for (size_t k = 1; k < groups[i].size(); k++)
+            multiply_relation(rel, relations[groups[i][k]], N);
+        filtered.push_back(rel);
+    }
+
+    if (verbose())
+    {
+        weight = column_weights(cols, alive, ncols);
+        size_t cols_after = ncols - count(weight.begin(), weight.end(), 0);
+        cout << "Filtering: " << m << " x " << cols_before << " matrix reduced to "
+             << filtered.size() << " x " << cols_after << " (" << duplicates << " duplicates, "
+             << singletons << " singletons, " << excess << " excess, " << merges << " merges)." << endl;
+    }
+
+    return filtered;
+}
@@ -0,0 +1,14 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <gmpxx.h>
+#include <vector>
+#include "smooth_relations.h"
+
+// Shrinks the relation matrix before the linear algebra: removes duplicate relations, repeatedly removes
+// relations with a prime that appears nowhere else (singletons), optionally drops excess relations and merges
+// columns of low weight by combining the relations that share them. Each returned relation is a product of
+// original relations, so dependencies found on them can be used with solve_dependency directly
+std::vector<Relation> filter_relations(const std::vector<Relation> &relations, const mpz_class &N);
+
+#endif // FILTER_H
@@ -0,0 +1,471 @@
+#include "lanczos.h"
+#include "config.h"
+#include "verbose.h"
+#include <omp.h>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+SparseMatrix build_sparse_matrix(const vector<Relation> &relations)
+{
+    SparseMatrix A;
+    A.num_relations = relations.size();
+    A.num_rows = relation_columns(relations);
+
+    // Relation-major storage, in the order of the relations
+    A.rel_start.assign(A.num_relations + 1, 0);
+    vector<size_t> row_count(A.num_rows, 0);
+    for (size_t i = 0; i < A.num_relations; i++)
+    {
+        for (unsigned int j : odd_columns(relations[i]))
+        {
+            A.rel_rows.push_back(j);
+            row_count[j]++;
+        }
+        A.rel_start[i + 1] = A.rel_rows.size();
+    }
+
+    // Transpose into row-major storage
+    A.row_start.assign(A.num_rows + 1, 0);
+    for (size_t j = 0; j < A.num_rows; j++)
+        A.row_start[j + 1] = A.row_start[j] + row_count[j];
+
+    A.row_rels.resize(A.rel_rows.size());
+    vector<size_t> fill_pos(A.row_start.begin(), A.row_start.end() - 1);
+    for (size_t i = 0; i < A.num_relations; i++)
+    {
+        for (size_t k = A.rel_start[i]; k < A.rel_start[i + 1]; k++)
+        {
+            A.row_rels[fill_pos[A.rel_rows[k]]++] = i;
+        }
+    }
+
+    return A;
+}
+
+// y = A * x, x has one word per relation and y one word per row
+static void mul_A(const SparseMatrix &A, const vector<uint64_t> &x, vector<uint64_t> &y)
+{
+#pragma omp parallel for schedule(static)
+    for (size_t j = 0; j < A.num_rows; j++)
+    {
+        uint64_t sum = 0;
+        for (size_t k = A.row_start[j]; k < A.row_start[j + 1]; k++)
+            sum ^= x[A.row_rels[k]];
+        y[j] = sum;
+    }
+}
+
+// y = A^T * x, x has one word per row and y one word per relation
+static void mul_At(const SparseMatrix &A, const vector<uint64_t> &x, vector<uint64_t> &y)
+{
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < A.num_relations; i++)
+    {
+        uint64_t sum = 0;
+        for (size_t k = A.rel_start[i]; k < A.rel_start[i + 1]; k++)
+            sum ^= x[A.rel_rows[k]];
+        y[i] = sum;
+    }
+}
+
+// 64x64 matrices are stored as 64 words, word i is row i and bit j is column j.
+// Tables of all byte combinations of the rows of b, so a word times b takes 8 lookups
+struct ByteTables
+{
+    uint64_t t[8][256];
+
+    explicit ByteTables(const uint64_t *b)
+    {
+        for (int k = 0; k < 8; k++)
+        {
+            t[k][0] = 0;
+            for (int v = 1; v < 256; v++)
+            {
+                int low = v & -v;
+                int bit = __builtin_ctz(low);
+                t[k][v] = t[k][v ^ low] ^ b[8 * k + bit];
+            }
+        }
+    }
+
+    uint64_t mul(uint64_t w) const
+    {
+        return t[0][w & 0xff] ^ t[1][(w >> 8) & 0xff] ^ t[2][(w >> 16) & 0xff] ^ t[3][(w >> 24) & 0xff] ^
+               t[4][(w >> 32) & 0xff] ^ t[5][(w >> 40) & 0xff] ^ t[6][(w >> 48) & 0xff] ^ t[7][w >> 56];
+    }
+};
+
+// c = a * b for 64x64 matrices (c may alias a or b)
+static void mul_64x64(const uint64_t *a, const uint64_t *b, uint64_t *c)
+{
+    ByteTables tables(b);
+    uint64_t result[64];
+    for (int i = 0; i < 64; i++)
+        result[i] = tables.mul(a[i]);
+    copy(result, result + 64, c);
+}
+
+// xy = x^T * y, x and y have n words and xy is 64x64
+static void mul_64xN_Nx64(const vector<uint64_t> &x, const vector<uint64_t> &y, uint64_t *xy)
+{
+    fill(xy, xy + 64, 0);
+
+#pragma omp parallel
+    {
+        uint64_t local[64] = {0};
+
+#pragma omp for schedule(static)
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            uint64_t xi = x[i];
+            uint64_t yi = y[i];
+            while (xi)
+            {
+                local[__builtin_ctzll(xi)] ^= yi;
+                xi &= xi - 1;
+            }
+        }
+
+#pragma omp critical
+        {
+            for (int j = 0; j < 64; j++)
+                xy[j] ^= local[j];
+        }
+    }
+}
+
+// y ^= v * x, v and y have n words and x is 64x64
+static void mul_Nx64_64x64_acc(const vector<uint64_t> &v, const uint64_t *x, vector<uint64_t> &y)
+{
+    ByteTables tables(x);
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        y[i] ^= tables.mul(v[i]);
+    }
+}
+
+// Chooses the columns S_i of V_i^T B V_i that form an invertible submatrix, giving priority to the columns
+// that were not chosen last time, and returns its inverse in winv. Follows Montgomery's construction
+static size_t find_nonsingular_sub(const uint64_t *t, size_t *s, const size_t *last_s, size_t last_dim, uint64_t *winv)
+{
+    uint64_t M[64][2];
+    for (int i = 0; i < 64; i++)
+    {
+        M[i][0] = t[i];
+        M[i][1] = 1ULL << i;
+    }
+
+    // Columns chosen last time go at the back of the order
+    size_t dim = 0;
+    size_t cols = 64;
+    uint64_t mask = 0;
+    for (size_t i = 0; i < last_dim; i++)
+    {
+        s[--cols] = last_s[i];
+        mask |= 1ULL << last_s[i];
+    }
+    for (size_t i = 0; i < 64; i++)
+    {
+        if (!(mask & (1ULL << i)))
+            s[dim++] = i;
+    }
+
+    dim = 0;
+    for (size_t i = 0; i < 64; i++)
+    {
+        mask = 1ULL << s[i];
+        uint64_t *row_i = M[s[i]];
+
+        // Find the next pivot row and put it in row i
+        size_t j;
+        for (j = i; j < 64; j++)
+        {
+            uint64_t *row_j = M[s[j]];
+            if (row_j[0] & mask)
+            {
+                swap(row_i[0], row_j[0]);
+                swap(row_i[1], row_j[1]);
+                break;
+            }
+        }
+
+        if (j < 64)
+        { // Eliminate the pivot column from all other rows, and accept the column
+            for (j = 0; j < 64; j++)
+            {
+                uint64_t *row_j = M[s[j]];
+                if (row_j != row_i && (row_j[0] & mask))
+                {
+                    row_j[0] ^= row_i[0];
+                    row_j[1] ^= row_i[1];
+                }
+            }
+            s[dim++] = s[i];
+            continue;
+        }
+
+        // Otherwise use the right half to make up for the missing pivot column
+        for (j = i; j < 64; j++)
+        {
+            uint64_t *row_j = M[s[j]];
+            if (row_j[1] & mask)
+            {
+                swap(row_i[0], row_j[0]);
+                swap(row_i[1], row_j[1]);
+                break;
+            }
+        }
+        if (j == 64)
+            return 0; // submatrix is not invertible
+
+        for (j = 0; j < 64; j++)
+        {
+            uint64_t *row_j = M[s[j]];
+            if (row_j != row_i && (row_j[1] & mask))
+            {
+                row_j[0] ^= row_i[0];
+                row_j[1] ^= row_i[1];
+            }
+        }
+        row_i[0] = row_i[1] = 0;
+    }
+
+    for (int i = 0; i < 64; i++)
+        winv[i] = M[i][1];
+
+    // The recurrence needs every column to appear in this iteration or the previous one
+    mask = 0;
+    for (size_t i = 0; i < dim; i++)
+        mask |= 1ULL << s[i];
+    for (size_t i = 0; i < last_dim; i++)
+        mask |= 1ULL << last_s[i];
+    if (mask != ~0ULL)
+        return 0;
+
+    return dim;
+}
+
+// The 128 columns of x and v span the nullspace vectors found by the iteration. Gaussian elimination
+// on their images A*x and A*v gives the combinations that A maps to zero
+static void combine_cofactors(const SparseMatrix &A,
+                              const vector<uint64_t> &x,
+                              const vector<uint64_t> &v,
+                              vector<vector<int>> &dependencies)
+{
+    size_t m = A.num_relations;
+    size_t rows = A.num_rows;
+    vector<uint64_t> ax(rows), av(rows);
+    mul_A(A, x, ax);
+    mul_A(A, v, av);
+
+    // Transpose: one bit vector over the rows of A (image) and over the relations (candidate) per column
+    size_t image_words = (rows + 63) / 64;
+    size_t cand_words = (m + 63) / 64;
+    vector<vector<uint64_t>> image(128, vector<uint64_t>(image_words, 0));
+    vector<vector<uint64_t>> cand(128, vector<uint64_t>(cand_words, 0));
+
+    for (size_t j = 0; j < rows; j++)
+    {
+        for (int b = 0; b < 64; b++)
+        {
+            if ((ax[j] >> b) & 1)
+                image[b][j / 64] |= 1ULL << (j % 64);
+            if ((av[j] >> b) & 1)
+                image[64 + b][j / 64] |= 1ULL << (j % 64);
+        }
+    }
+    for (size_t i = 0; i < m; i++)
+    {
+        for (int b = 0; b < 64; b++)
+        {
+            if ((x[i] >> b) & 1)
+                cand[b][i / 64] |= 1ULL << (i % 64);
+            if ((v[i] >> b) & 1)
+                cand[64 + b][i / 64] |= 1ULL << (i % 64);
+        }
+    }
+
+    size_t rank = 0;
+    for (size_t j = 0; j < rows && rank < 128; j++)
+    {
+        uint64_t bit = 1ULL << (j % 64);
+        size_t pivot = 128;
+        for (size_t k = rank; k < 128; k++)
+        {
+            if (image[k][j / 64] & bit)
+            {
+                pivot = k;
+                break;
+            }
+        }
+        if (pivot == 128)
+            continue;
+
+        swap(image[rank], image[pivot]);
+        swap(cand[rank], cand[pivot]);
+        for (size_t k = rank + 1; k < 128; k++)
+        {
+            if (image[k][j / 64] & bit)
+            {
+                for (size_t w = 0; w < image_words; w++)
+                    image[k][w] ^= image[rank][w];
+                for (size_t w = 0; w < cand_words; w++)
+                    cand[k][w] ^= cand[rank][w];
+            }
+        }
+        rank++;
+    }
+
+    // Remaining vectors have a zero image, keep the nonzero ones that differ
+    dependencies.clear();
+    for (size_t k = rank; k < 128; k++)
+    {
+        bool nonzero = false;
+        for (size_t w = 0; w < cand_words && !nonzero; w++)
+            nonzero = cand[k][w] != 0;
+        if (!nonzero)
+            continue;
+
+        bool duplicate = false;
+        for (size_t l = rank; l < k && !duplicate; l++)
+            duplicate = cand[l] == cand[k];
+        if (duplicate)
+            continue;
+
+        vector<int> dep(m, 0);
+        for (size_t i = 0; i < m; i++)
+            dep[i] = (cand[k][i / 64] >> (i % 64)) & 1;
+        dependencies.push_back(dep);
+    }
+}
+
+// One run of the iteration from a random start, returns false on breakdown
+static bool block_lanczos_core(const SparseMatrix &A, unsigned long seed, vector<vector<int>> &dependencies)
+{
+    size_t n = A.num_relations;
+    mt19937_64 rng(seed);
+
+    vector<uint64_t> v[3], vnext(n), v0(n), x(n), scratch(A.num_rows);
+    for (int k = 0; k < 3; k++)
+        v[k].assign(n, 0);
+
+    // Solve B * x = B * y for B = A^T A and a random y, so that x - y is in the nullspace of B
+    for (size_t i = 0; i < n; i++)
+        x[i] = rng();
+    mul_A(A, x, scratch);
+    mul_At(A, scratch, v[0]);
+    v0 = v[0];
+
+    uint64_t vt_a_v[2][64] = {{0}}, vt_a2_v[2][64] = {{0}}, winv[3][64] = {{0}};
+    uint64_t d[64], e[64], f[64], f2[64];
+    size_t s[2][64];
+    size_t dim0 = 0, dim1 = 64;
+    uint64_t mask0, mask1 = ~0ULL;
+    for (size_t i = 0; i < 64; i++)
+        s[1][i] = i;
+
+    size_t max_iterations = n / 60 + 100;
+    for (size_t iter = 0;; iter++)
+    {
+        if (iter > max_iterations)
+            return false;
+
+        // vnext = B * v[0]
+        mul_A(A, v[0], scratch);
+        mul_At(A, scratch, vnext);
+
+        mul_64xN_Nx64(v[0], vnext, vt_a_v[0]);
+        mul_64xN_Nx64(vnext, vnext, vt_a2_v[0]);
+
+        // Finished once v[0] is B-orthogonal to itself
+        bool done = true;
+        for (int i = 0; i < 64 && done; i++)
+            done = vt_a_v[0][i] == 0;
+        if (done)
+            break;
+
+        dim0 = find_nonsingular_sub(vt_a_v[0], s[0], s[1], dim1, winv[0]);
+        if (dim0 == 0)
+            return false;
+
+        mask0 = 0;
+        for (size_t i = 0; i < dim0; i++)
+            mask0 |= 1ULL << s[0][i];
+
+        // d = I - Winv_i (V_i^T B^2 V_i S_i S_i^T + V_i^T B V_i)
+        for (int i = 0; i < 64; i++)
+            d[i] = (vt_a2_v[0][i] & mask0) ^ vt_a_v[0][i];
+        mul_64x64(winv[0], d, d);
+        for (int i = 0; i < 64; i++)
+            d[i] ^= 1ULL << i;
+
+        // e = Winv_{i-1} V_i^T B V_i S_i S_i^T
+        mul_64x64(winv[1], vt_a_v[0], e);
+        for (int i = 0; i < 64; i++)
+            e[i] &= mask0;
+
+        // f = Winv_{i-2} (I - V_{i-1}^T B V_{i-1} Winv_{i-1}) (V_{i-1}^T B^2 V_{i-1} S_{i-1} S_{i-1}^T + V_{i-1}^T B V_{i-1}) S_i S_i^T
+        mul_64x64(vt_a_v[1], winv[1], f);
+        for (int i = 0; i < 64; i++)
+            f[i] ^= 1ULL << i;
+        mul_64x64(winv[2], f, f);
+        for (int i = 0; i < 64; i++)
+            f2[i] = ((vt_a2_v[1][i] & mask1) ^ vt_a_v[1][i]) & mask0;
+        mul_64x64(f, f2, f);
+
+        // v_{i+1} = B V_i S_i S_i^T + V_i d + V_{i-1} e + V_{i-2} f
+        for (size_t i = 0; i < n; i++)
+            vnext[i] &= mask0;
+        mul_Nx64_64x64_acc(v[0], d, vnext);
+        mul_Nx64_64x64_acc(v[1], e, vnext);
+        mul_Nx64_64x64_acc(v[2], f, vnext);
+
+        // x += V_i Winv_i V_i^T v0
+        mul_64xN_Nx64(v[0], v0, d);
+        mul_64x64(winv[0], d, d);
+        mul_Nx64_64x64_acc(v[0], d, x);
+
+        // Rotate the history
+        swap(v[2], v[1]);
+        swap(v[1], v[0]);
+        swap(v[0], vnext);
+        copy(winv[1], winv[1] + 64, winv[2]);
+        copy(winv[0], winv[0] + 64, winv[1]);
+        copy(vt_a_v[0], vt_a_v[0] + 64, vt_a_v[1]);
+        copy(vt_a2_v[0], vt_a2_v[0] + 64, vt_a2_v[1]);
+        copy(s[0], s[0] + 64, s[1]);
+        mask1 = mask0;
+        dim1 = dim0;
+    }
+
+    combine_cofactors(A, x, v[0], dependencies);
+    return !dependencies.empty();
+}
+
+bool block_lanczos(const vector<Relation> &relations, vector<vector<int>> &dependencies)
+{
+    if (relations.empty())
+        return false;
+
+    SparseMatrix A = build_sparse_matrix(relations);
+    if (verbose())
+    {
+        cout << "Block Lanczos on " << A.num_rows << " x " << A.num_relations << " matrix with "
+             << A.rel_rows.size() << " nonzeros." << endl;
+    }
+
+    // The iteration can break down for an unlucky start, so retry with another one
+    for (unsigned long attempt = 0; attempt < LANCZOS_RETRIES; attempt++)
+    {
+        if (block_lanczos_core(A, LANCZOS_SEED + attempt, dependencies))
+            return true;
+    }
+
+    dependencies.clear();
+    return false;
+}
@@ -0,0 +1,28 @@
+#ifndef LANCZOS_H
+#define LANCZOS_H
+
+#include <cstdint>
+#include <vector>
+#include "smooth_relations.h"
+
+// Sparse GF(2) matrix A with one column per relation and one row per exponent (sign, then factor base primes).
+// Stored in compressed sparse-row form both by relation and by prime, so that products with A and A^T
+// are both gathers and can be split across threads without atomics
+struct SparseMatrix
+{
+    size_t num_relations;                 // columns of A
+    size_t num_rows;                      // rows of A (sign and factor base primes)
+    std::vector<size_t> rel_start;        // offsets into rel_rows for each relation
+    std::vector<unsigned int> rel_rows;   // rows with an odd exponent in each relation
+    std::vector<size_t> row_start;        // offsets into row_rels for each row
+    std::vector<unsigned int> row_rels;   // relations with an odd exponent in each row
+};
+
+// Builds the sparse matrix straight from the exponent vectors of the relations
+SparseMatrix build_sparse_matrix(const std::vector<Relation> &relations);
+
+// Block Lanczos (Montgomery) over 64-bit blocks to find dependencies between the relations,
+// in the same form as add_relations. Returns false if the iteration fails
+bool block_lanczos(const std::vector<Relation> &relations, std::vector<std::vector<int>> &dependencies);
+
+#endif // LANCZOS_H
@@ -0,0 +1,280 @@
+#include "large_prime.h"
+#include "config.h"
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+unsigned long large_prime_bound(const FactorBase &factor_base)
+{
+    unsigned long p_max = factor_base.primes.back();
+    unsigned long bound = p_max * LARGE_PRIME_MULTIPLIER;
+
+    // Any cofactor below p_max^2 with no factor base prime factor is prime
+    if (bound / p_max >= p_max)
+        bound = p_max * p_max - 1;
+
+    return bound;
+}
+
+unsigned long double_large_prime_bound(const FactorBase &factor_base, const mpz_class &N)
+{
+    if (!USE_LARGE_PRIMES || !USE_DOUBLE_LARGE_PRIMES ||
+        mpz_sizeinbase(N.get_mpz_t(), 10) < DOUBLE_LARGE_PRIME_MIN_DIGITS)
+        return 0;
+
+    // Keep the cofactor within 62 bits so the 64-bit arithmetic below can't overflow
+    double bound = pow(static_cast<double>(large_prime_bound(factor_base)), DOUBLE_LARGE_PRIME_EXPONENT);
+    if (bound > 4.0e18)
+        bound = 4.0e18;
+
+    return static_cast<unsigned long>(bound);
+}
+
+// a * b mod m without overflow
+static uint64_t mulmod64(uint64_t a, uint64_t b, uint64_t m)
+{
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) % m);
+}
+
+static uint64_t powmod64(uint64_t base, uint64_t exp, uint64_t mod)
+{
+    uint64_t result = 1;
+    base %= mod;
+    while (exp > 0)
+    {
+        if (exp & 1)
+            result = mulmod64(result, base, mod);
+        base = mulmod64(base, base, mod);
+        exp >>= 1;
+    }
+    return result;
+}
+
+// Deterministic Miller-Rabin for 64-bit integers
+static bool is_prime64(uint64_t n)
+{
+    if (n < 2)
+        return false;
+
+    static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    for (uint64_t p : bases)
+    {
+        if (n % p == 0)
+            return n == p;
+    }
+
+    uint64_t d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0)
+    {
+        d >>= 1;
+        s++;
+    }
+
+    for (uint64_t a : bases)
+    {
+        uint64_t x = powmod64(a, d, n);
+        if (x == 1 || x == n - 1)
+            continue;
+
+        bool witness = true;
+        for (int r = 1; r < s && witness; r++)
+        {
+            x = mulmod64(x, x, n);
+            if (x == n - 1)
+                witness = false;
+        }
+        if (witness)
+            return false;
+    }
+    return true;
+}
+
+static uint64_t gcd64(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Pollard rho with Brent's cycle detection, returns a nontrivial factor of the composite n or 0
+static uint64_t pollard_rho64(uint64_t n)
+{
+    if (n % 2 == 0)
+        return 2;
+
+    for (uint64_t c = 1; c < 20; c++)
+    {
+        uint64_t y = 2, x = 2, q = 1, g = 1, ys = 2;
+        uint64_t r = 1;
+        const uint64_t m = 128;
+
+        while (g == 1)
+        {
+            x = y;
+            for (uint64_t i = 0; i < r; i++)
+                y = (mulmod64(y, y, n) + c) % n;
+
+            // Batch the gcds by multiplying |x - y| together
+            for (uint64_t k = 0; k < r && g == 1; k += m)
+            {
+                ys = y;
+                for (uint64_t i = 0; i < m && i < r - k; i++)
+                {
+                    y = (mulmod64(y, y, n) + c) % n;
+                    q = mulmod64(q, x > y ? x - y : y - x, n);
+                }
+                g = gcd64(q, n);
+            }
+            r <<= 1;
+        }
+
+        if (g == n)
+        { // Went too far, step back one at a time
+            do
+            {
+                ys = (mulmod64(ys, ys, n) + c) % n;
+                g = gcd64(x > ys ? x - ys : ys - x, n);
+            } while (g == 1);
+        }
+
+        if (g != n)
+            return g;
+    }
+    return 0;
+}
+
+bool split_cofactor(const mpz_class &cofactor,
+                    unsigned long large_bound,
+                    unsigned long double_bound,
+                    unsigned long &large_prime1,
+                    unsigned long &large_prime2)
+{
+    large_prime1 = 1;
+    large_prime2 = 1;
+
+    if (cofactor == 1)
+        return true;
+
+    if (!USE_LARGE_PRIMES || !mpz_fits_ulong_p(cofactor.get_mpz_t()))
+        return false;
+
+    unsigned long c = cofactor.get_ui();
+    if (c <= large_bound)
+    { // No factor base prime divides it and it is below p_max^2, so it is prime
+        large_prime1 = c;
+        return true;
+    }
+
+    // Two large primes: it must be composite with both factors below the large prime bound
+    if (c > double_bound || is_prime64(c))
+        return false;
+
+    uint64_t f = pollard_rho64(c);
+    if (f == 0)
+        return false;
+
+    uint64_t g = c / f;
+    if (f > large_bound || g > large_bound)
+        return false;
+
+    large_prime1 = f;
+    large_prime2 = g;
+    return true;
+}
+
+// Vertex of the graph for the given large prime, created on first use
+static size_t graph_vertex(PartialRelations &partials, unsigned long prime)
+{
+    map<unsigned long, size_t>::iterator it = partials.vertex_index.find(prime);
+    if (it != partials.vertex_index.end())
+        return it->second;
+
+    size_t v = partials.parent.size();
+    partials.vertex_index.insert(make_pair(prime, v));
+    partials.parent.push_back(v);
+    partials.adjacency.push_back(vector<pair<size_t, size_t>>());
+    return v;
+}
+
+// Union-find root with path halving
+static size_t graph_root(PartialRelations &partials, size_t v)
+{
+    while (partials.parent[v] != v)
+    {
+        partials.parent[v] = partials.parent[partials.parent[v]];
+        v = partials.parent[v];
+    }
+    return v;
+}
+
+bool add_partial_relation(PartialRelations &partials,
+                          const Relation &rel,
+                          const mpz_class &N,
+                          Relation &full)
+{
+    // A single large prime is an edge to vertex 1
+    unsigned long large_prime1 = rel.large_primes[0];
+    unsigned long large_prime2 = rel.large_primes.size() > 1 ? rel.large_primes[1] : 1;
+
+    partials.partial_count++;
+    if (large_prime1 != 1 && large_prime2 != 1)
+        partials.double_count++;
+
+    size_t u = graph_vertex(partials, large_prime1);
+    size_t v = graph_vertex(partials, large_prime2);
+    size_t root_u = graph_root(partials, u);
+    size_t root_v = graph_root(partials, v);
+
+    if (root_u != root_v)
+    { // Joins two components, so no cycle: keep the edge in the spanning forest
+        partials.parent[root_u] = root_v;
+        size_t index = partials.relations.size();
+        partials.relations.push_back(rel);
+        partials.adjacency[u].push_back(make_pair(v, index));
+        partials.adjacency[v].push_back(make_pair(u, index));
+        return false;
+    }
+
+    // u and v are already connected: walk the forest from u to v to find the rest of the cycle
+    map<size_t, pair<size_t, size_t>> previous; // vertex -> (previous vertex, relation index)
+    vector<size_t> queue(1, u);
+    previous.insert(make_pair(u, make_pair(u, partials.relations.size())));
+    for (size_t head = 0; head < queue.size() && previous.find(v) == previous.end(); head++)
+    {
+        size_t w = queue[head];
+        for (const pair<size_t, size_t> &edge : partials.adjacency[w])
+        {
+            if (previous.find(edge.first) == previous.end())
+            {
+                previous.insert(make_pair(edge.first, make_pair(w, edge.second)));
+                queue.push_back(edge.first);
+            }
+        }
+    }
+
+    vector<size_t> cycle;
+    for (size_t w = v; w != u; w = previous[w].first)
+    {
+        cycle.push_back(previous[w].second);
+    }
+
+    // The same relation found twice would only give a trivial square
+    if (cycle.size() == 1 && partials.relations[cycle[0]].x == rel.x)
+        return false;
+
+    // Every large prime appears squared in the product, so it doesn't change the exponent vector mod 2
+    full = rel;
+    for (size_t index : cycle)
+    {
+        multiply_relation(full, partials.relations[index], N);
+    }
+
+    partials.combined_count++;
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef LARGE_PRIME_H
+#define LARGE_PRIME_H
+
+#include <gmpxx.h>
+#include <map>
+#include <vector>
+#include "smooth_relations.h"
+#include "factors.h"
+
+// Partial relations (B-smooth apart from one or two primes above B) kept as edges of a graph
+// whose vertices are the large primes, with vertex 1 standing for "no large prime".
+// Any cycle in this graph multiplies into a full relation, since every large prime on it appears squared
+struct PartialRelations
+{
+    std::vector<Relation> relations;                                     // partial relation stored for each forest edge
+    std::map<unsigned long, size_t> vertex_index;                        // large prime -> vertex
+    std::vector<size_t> parent;                                          // union-find parent of each vertex
+    std::vector<std::vector<std::pair<size_t, size_t>>> adjacency;       // (neighbour, relation index) for each vertex
+    size_t partial_count;                                                // number of partial relations found
+    size_t double_count;                                                 // how many of them had two large primes
+    size_t combined_count;                                               // number of full relations made out of cycles
+
+    PartialRelations() : partial_count(0), double_count(0), combined_count(0) {}
+};
+
+// Largest cofactor kept as the large prime of a partial relation (always below B^2, so it is prime)
+unsigned long large_prime_bound(const FactorBase &factor_base);
+
+// Largest cofactor split into two large primes, or 0 if double large primes aren't used for this N
+unsigned long double_large_prime_bound(const FactorBase &factor_base, const mpz_class &N);
+
+// Splits the cofactor left after trial division into at most two large primes (1 when absent).
+// Returns false if the candidate can't be used in a full or partial relation
+bool split_cofactor(const mpz_class &cofactor,
+                    unsigned long large_bound,
+                    unsigned long double_bound,
+                    unsigned long &large_prime1,
+                    unsigned long &large_prime2);
+
+// Adds the partial relation (with one or two large primes) to the graph. Returns true when it closes a cycle,
+// with the product of the relations on the cycle in full
+bool add_partial_relation(PartialRelations &partials,
+                          const Relation &rel,
+                          const mpz_class &N,
+                          Relation &full);
+
+#endif // LARGE_PRIME_H
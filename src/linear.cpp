@@ -2,173 +2,170 @@
 #include "smooth_relations.h"
 #include <omp.h>
 
-// performs gaussian eliminiation on a mod 2 matrix
-bool gaussian_elimination_all(const std::vector<std::vector<int>> &M_input, std::vector<std::vector<int>> &dependencies)
+#include <cstdint>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// dst ^= src over count 64-bit words, using the widest SIMD registers available
+static inline void xor_words(uint64_t *dst, const uint64_t *src, size_t count)
 {
-    int m = M_input.size();
-    if (m == 0)
-        return false;
-    int n = M_input[0].size();
-
-    std::vector<std::vector<int>> M = M_input;
-
-    // T used to remake the relationships that have dependencies
-    std::vector<std::vector<int>> T(m, std::vector<int>(m, 0));
-
-#pragma omp parallel for
-    for (int i = 0; i < m; i++)
-        T[i][i] = 1;
-
-    // Keep track of processed rows and columns for faster elimination
-    std::vector<bool> processed_rows(m, false);
-    std::vector<bool> processed_cols(n, false);
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(a, b));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(a, b));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 2 <= count; i += 2)
+    {
+        vst1q_u64(dst + i, veorq_u64(vld1q_u64(dst + i), vld1q_u64(src + i)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        dst[i] ^= src[i];
+    }
+}
 
-    // Perform Gaussian elimination
-    for (int col = 0; col < n; col++)
+// Reduces row (and its history) by the pivots of the given rows wherever it has a bit in their pivot column
+static void reduce_row(const IncrementalMatrix &matrix, size_t pivot_limit, std::vector<uint64_t> &row, std::vector<uint64_t> &history)
+{
+    for (size_t w = 0; w < matrix.words; w++)
     {
-        // Try to find pivot row
-        int pivot_row = -1;
-        for (int row = 0; row < m; row++)
+        uint64_t pending = row[w];
+        while (pending)
         {
-            if (!processed_rows[row] && M[row][col] == 1)
-            {
-                pivot_row = row; // Found a pivot row
-                break;
-            }
+            size_t col = w * 64 + __builtin_ctzll(pending);
+            pending &= pending - 1;
+
+            long p = matrix.pivot[col];
+            if (p < 0 || static_cast<size_t>(p) >= pivot_limit)
+                continue;
+
+            // The pivot row is zero before col, so it only changes this word and the later ones
+            const std::vector<uint64_t> &pivot_row = matrix.rows[p];
+            xor_words(&row[w], &pivot_row[w], matrix.words - w);
+            xor_words(&history[0], &matrix.history[p][0], matrix.history[p].size());
+            pending = row[w] & ~((2ULL << (col % 64)) - 1);
         }
+    }
+}
 
-        if (pivot_row == -1)
-        {
-            // No pivot found in this column
-            continue;
-        }
+bool add_relations(IncrementalMatrix &matrix,
+                   const std::vector<Relation> &relations,
+                   std::vector<std::vector<int>> &dependencies)
+{
+    dependencies.clear();
+    size_t first = matrix.relations_added;
+    size_t m = relations.size();
+    if (first >= m)
+        return false;
 
-        // Mark the pivot row and column as processed so we don't use them again
-        processed_cols[col] = true;
-        processed_rows[pivot_row] = true;
+    size_t history_words = (m + 63) / 64;
+    std::vector<std::vector<uint64_t>> new_rows(m - first, std::vector<uint64_t>(matrix.words, 0));
+    std::vector<std::vector<uint64_t>> new_history(m - first, std::vector<uint64_t>(history_words, 0));
 
-// To eliminate all 1's in the column from other rows
-#pragma omp parallel for // we can parallelize this operation since each row operation is independent
-        for (int row = 0; row < m; row++)
-        {
-            if (row != pivot_row && M[row][col] == 1)
-            {
-                for (int j = col; j < n; j++)
-                {
-                    M[row][j] = (M[row][j] + M[pivot_row][j]) % 2;
-                }
-
-                // Keep track of chanes in T
-                for (int j = 0; j < m; j++)
-                {
-                    T[row][j] = (T[row][j] + T[pivot_row][j]) % 2;
-                }
-            }
-        }
-    }
+    // The pivots from earlier attempts don't change, so every new row can be reduced by them in parallel
+    size_t old_pivots = matrix.rows.size();
+#pragma omp parallel for schedule(dynamic, 16)
+    for (size_t i = first; i < m; i++)
+    {
+        std::vector<uint64_t> &row = new_rows[i - first];
+        for (unsigned int column : odd_columns(relations[i]))
+            row[column / 64] |= 1ULL << (column % 64);
+        new_history[i - first][i / 64] |= 1ULL << (i % 64);
 
-    dependencies.clear();
+        reduce_row(matrix, old_pivots, row, new_history[i - first]);
+    }
 
-// One again, can parallelize check for zero rows
-#pragma omp parallel
+    // The new rows are then reduced by each other in order, becoming pivots or dependencies
+    for (size_t i = first; i < m; i++)
     {
-        std::vector<std::vector<int>> local_dependencies;
+        std::vector<uint64_t> &row = new_rows[i - first];
+        std::vector<uint64_t> &history = new_history[i - first];
+        reduce_row(matrix, matrix.rows.size(), row, history);
 
-#pragma omp for schedule(dynamic)
-        for (int i = 0; i < m; i++)
-        {
-            if (processed_rows[i])
-                continue; // Skip processed rows as they have pivots
-
-            bool is_zero_row = true;
-            for (int j = 0; j < n; j++)
-            { //checks each column in the row for nonzero value
-                if (M[i][j] != 0)
-                {
-                    is_zero_row = false;
-                    break;
-                }
-            }
-
-            if (is_zero_row)
-            { // means we found a dependency
-                local_dependencies.push_back(T[i]);
-            }
-        }
+        size_t w = 0;
+        while (w < matrix.words && row[w] == 0)
+            w++;
 
-// Need to check rows that were processed since they might have been made zero rows
-#pragma omp for schedule(dynamic)
-        for (int i = 0; i < m; i++)
+        if (w < matrix.words)
         {
-            if (!processed_rows[i])
-                continue; // just did this
-
-            bool is_zero_row = true;
-            for (int j = 0; j < n; j++)
-            {
-                if (M[i][j] != 0)
-                {
-                    is_zero_row = false;
-                    break;
-                }
-            }
-
-            if (is_zero_row)
-            {
-                local_dependencies.push_back(T[i]);
-            }
+            size_t col = w * 64 + __builtin_ctzll(row[w]);
+            matrix.pivot[col] = matrix.rows.size();
+            matrix.rows.push_back(row);
+            matrix.history.push_back(history);
         }
-
-// Merge into global dependencies
-#pragma omp critical
+        else
         {
-            dependencies.insert(dependencies.end(), local_dependencies.begin(), local_dependencies.end());
+            std::vector<int> dep(m, 0);
+            for (size_t k = 0; k < m; k++)
+                dep[k] = (history[k / 64] >> (k % 64)) & 1;
+            dependencies.push_back(dep);
         }
     }
 
+    matrix.relations_added = m;
     return !dependencies.empty();
 }
 
 mpz_class solve_dependency(const std::vector<Relation> &relations,
                            const std::vector<int> &dep,
+                           const FactorBase &factor_base,
                            const mpz_class &N)
 {
-    int num_relations_used = 0;
-    for (size_t i = 0; i < dep.size(); i++)
-    {    // Counting each relation in dependency 
-        if (dep[i] == 1)
-        {
-            num_relations_used++;
-        }
-    }
-
-    std::vector<unsigned long> a_factors;
-    a_factors.reserve(num_relations_used * 10); // Estimate for average factors per relation
-
     mpz_class B = 1;
 
-    // Process each relation in the dependency
+    // Add up the exponents of the relations in the dependency, which are all even in the sum
+    std::vector<unsigned long> exponents(factor_base.size() + 1, 0);
+    std::vector<unsigned long> large_primes;
     for (size_t i = 0; i < dep.size(); i++)
     {
         if (dep[i] == 1)
         {
             mpz_mul(B.get_mpz_t(), B.get_mpz_t(), relations[i].x.get_mpz_t());
             B %= N;
+
+            for (const std::pair<unsigned int, unsigned int> &f : relations[i].factors)
+                exponents[f.first] += f.second;
+            large_primes.insert(large_primes.end(), relations[i].large_primes.begin(), relations[i].large_primes.end());
         }
     }
 
-    // Compute A by square root of the product of all x^2 - n (Q) values
-    mpz_class A_sq = 1;
+    // A is the square root of the product of the Q values, built from half the exponents mod N
+    // (column 0 is the sign, which is positive in the product)
+    mpz_class A = 1, power;
+    for (size_t j = 1; j < exponents.size(); j++)
+    {
+        if (exponents[j] == 0)
+            continue;
+        mpz_class p = factor_base.primes[j - 1];
+        mpz_powm_ui(power.get_mpz_t(), p.get_mpz_t(), exponents[j] / 2, N.get_mpz_t());
+        A = (A * power) % N;
+    }
 
-    for (size_t i = 0; i < dep.size(); i++)
+    // Each large prime appears an even number of times
+    std::sort(large_primes.begin(), large_primes.end());
+    for (size_t i = 0; i + 1 < large_primes.size(); i += 2)
     {
-        if (dep[i] == 1)
-        {
-            mpz_mul(A_sq.get_mpz_t(), A_sq.get_mpz_t(), relations[i].Q.get_mpz_t());
-        }
+        A = (A * large_primes[i]) % N;
     }
-    // basic principle
-    mpz_class A = isqrt(A_sq);
+
     mpz_class diff, factor;
     diff = B - A;
     mpz_gcd(factor.get_mpz_t(), diff.get_mpz_t(), N.get_mpz_t());
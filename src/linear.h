@@ -2,17 +2,36 @@
 #define LINEAR_H
 
 #include <gmpxx.h>
+#include <cstdint>
 #include <vector>
 #include "smooth_relations.h"
 
 struct Relation;
 
-// Gaussian elimination to find all dependencies in a matrix
-bool gaussian_elimination_all(const std::vector<std::vector<int>> &M_input, std::vector<std::vector<int>> &dependencies);
+// Echelon form kept between attempts, so only the relations found since the last attempt need to be eliminated
+struct IncrementalMatrix
+{
+    size_t num_columns;                          // exponent columns (sign and factor base primes)
+    size_t words;                                // 64-bit words in each row
+    std::vector<std::vector<uint64_t>> rows;     // pivot rows, each zero before its pivot column
+    std::vector<std::vector<uint64_t>> history;  // relations added together to make each pivot row
+    std::vector<long> pivot;                     // row with its pivot in each column, or -1
+    size_t relations_added;                      // relations eliminated so far
+
+    IncrementalMatrix(size_t columns)
+        : num_columns(columns), words((columns + 63) / 64), pivot(columns, -1), relations_added(0) {}
+};
+
+// Reduces the relations added since the last call against the stored pivots. Relations that reduce to zero
+// give new dependencies, each a 0/1 vector over the relations marking the ones multiplied together
+bool add_relations(IncrementalMatrix &matrix,
+                   const std::vector<Relation> &relations,
+                   std::vector<std::vector<int>> &dependencies);
 
 // Solve the dependency relation to find a nontrivial factor
 mpz_class solve_dependency(const std::vector<Relation> &relations,
                            const std::vector<int> &dep,
+                           const FactorBase &factor_base,
                            const mpz_class &N);
 
 #endif // LINEAR_H
\ No newline at end of file
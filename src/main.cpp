@@ -1,20 +1,18 @@
 #include <iostream>
-#include <vector>
+#include <fstream>
 #include <cstdlib>
-#include <set>
+#include <vector>
 #include <chrono>
-#include <cmath>
 #include <gmpxx.h>  // Use GMP library to handle large integers
 #include "config.h" // Global configuration file
-#include "smoothness_bound.h"
-#include "factors.h"
-#include "smooth_relations.h"
-#include "probable_prime.h"
-#include "linear.h"
+#include "factorize.h"
+#include "distributed.h"
+#include "batch.h"
+#include "autotune.h"
 
 using namespace std;
 
-int print_factors_set(const set<mpz_class> &factors, const chrono::high_resolution_clock::time_point &start)
+int print_factorization(const Factorization &factorization, const chrono::high_resolution_clock::time_point &start)
 {
     if (VERBOSE)
     { // Print out time taken to find factors
@@ -26,290 +24,114 @@ int print_factors_set(const set<mpz_class> &factors, const chrono::high_resoluti
         cout << string(60, '-') << endl;
     }
 
-    cout << "Final Factor(s): ";
-
-    for (const auto &factor : factors)
-    {
-        cout << factor.get_str() << " ";
-    }
-    cout << endl;
+    cout << "Final Factor(s): " << format_factorization(factorization, " ") << endl;
     return 0;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
-    // Promt user for composite number n
-    string nStr;
-    cout << "Enter composite number n: ";
-    cin >> nStr;
+    // Workers get the number to factor from the coordinator
+    if (argc == 4 && string(argv[1]) == "--worker")
+        return run_worker(argv[2], atoi(argv[3]));
 
-    auto start = chrono::high_resolution_clock::now();
+    // Many numbers, one per line, from a file or stdin
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--batch")
+    {
+        if (argc == 2 || string(argv[2]) == "-")
+            return run_batch(cin, cout);
 
-    for (char c : nStr)
-    { // Check if the input is a valid number
-        if (!isdigit(c))
+        ifstream input(argv[2]);
+        if (!input)
         {
-            cerr << "Error: Invalid input: '" << c << "'. Enter a valid composite number." << endl;
+            cerr << "Error: could not open " << argv[2] << endl;
             return EXIT_FAILURE;
         }
+        return run_batch(input, cout);
     }
 
-    if (nStr.length() > MAX_DIGITS)
-    { // Only proceed if the number of digits isn't too long
-        cerr << "Error: Number exceeds the maximum allowed digit limit of " << MAX_DIGITS << "." << endl;
-        return EXIT_FAILURE;
-    }
-
-    if (VERBOSE)
-    {
-        cout << string(60, '-') << endl;
-    }
-
-    mpz_class n(nStr); // n stores the composite number as a GMP integer to handle large numbers
-
-    set<mpz_class> final_factors; // Use a set to store unique factors
-
-    // use sieve of Eratosthenes to find small prime factors up till log(n)
-
-    double n_d = n.get_d(); // we can use double as we don't need precision here as log can be approximate
-    unsigned long limit = static_cast<unsigned long>(ceil(log(n_d)));
-    if (VERBOSE)
-    {
-        cout << "Finding factors up to log(n) = " << limit << " using brute force" << endl;
-    }
-
-    // actual sieve
-    vector<bool> is_prime(limit + 1, true);
-    if (limit >= 0)
-    {
-        is_prime[0] = is_prime[1] = false;
-    }
-
-    for (unsigned long i = 2; i * i <= limit; ++i)
+    // Tune the parameters on generated semiprimes, or on the numbers in a file, and write the table
+    if (argc >= 2 && argc <= 4 && string(argv[1]) == "--autotune")
     {
-        if (is_prime[i])
+        vector<mpz_class> numbers;
+        if (argc == 4)
         {
-            for (unsigned long j = i * i; j <= limit; j += i)
+            ifstream input(argv[3]);
+            string line;
+            if (!input)
             {
-                is_prime[j] = false;
+                cerr << "Error: could not open " << argv[3] << endl;
+                return EXIT_FAILURE;
             }
-        }
-    }
-
-    vector<unsigned long> primes;
-    for (unsigned long i = 2; i <= limit; ++i)
-    {
-        if (is_prime[i])
-        {
-            primes.push_back(i);
-        }
-    }
-
-    // Remove small prime factors
-    for (unsigned long p : primes)
-    {
-        while (n % p == 0)
-        { // keep dividing n by p until it is no longer divisible
-            mpz_class prime_factor(p);
-            if (final_factors.find(prime_factor) == final_factors.end())
+            while (getline(input, line))
             {
-                if (VERBOSE)
-                {
-                    cout << "Removed factor: " << p << endl;
-                }
-                final_factors.insert(prime_factor);
+                size_t first = line.find_first_not_of(" \t\r");
+                if (first != string::npos && isdigit(line[first]))
+                    numbers.push_back(mpz_class(line.substr(first, line.find_first_not_of("0123456789", first) - first)));
             }
-            n /= p;
         }
+        return run_autotune(argc >= 3 ? argv[2] : PARAMETER_FILE, numbers);
     }
 
-    if (n == 1)
-    { // If n is fully factorized
-        print_factors_set(final_factors, start);
-        return EXIT_SUCCESS;
-    }
-
-    if (VERBOSE)
-    {
-        cout << "Remaining number after removing small factors: " << n << endl;
-    }
-
-    // Miller-Rabin strong probable prime test: if n is prime, do not proceed
-    if (EXIT_ON_MILLER_RABIN_FAIL && isProbablePrime(n, MAX_ITERATIONS))
+    unsigned short coordinator_port = 0;
+    string telemetry_file = TELEMETRY_FILE;
+    for (int i = 1; i < argc; i++)
     {
-        if (final_factors.empty())
+        string arg = argv[i];
+        if (arg == "--coordinator" && i + 1 < argc)
+            coordinator_port = atoi(argv[++i]);
+        else if (arg == "--telemetry" && i + 1 < argc)
+            telemetry_file = argv[++i];
+        else
         {
-            // If n is prime and has no factors, error out
-            cerr << "Error: The number is prime. Enter a composite number." << endl;
+            cerr << "Usage: " << argv[0]
+                 << " [--batch [file] | --autotune [table [numbers]] | --worker <host> <port> |"
+                 << " [--coordinator <port>] [--telemetry <file>]]" << endl;
             return EXIT_FAILURE;
         }
-
-        // If n is prime and has factors, we are done
-        if (n != 1)
-        {
-            final_factors.insert(n); // Add the remaining prime number to the factors
-        }
-
-        print_factors_set(final_factors, start);
-        return EXIT_SUCCESS;
     }
 
-    if (EXIT_ON_MILLER_RABIN_FAIL && VERBOSE)
-    {
-        cout << "Miller-Rabin passed: number is likely composite." << endl;
-    }
-
-    // Check if n is a perfect square
-    mpz_class sqrt_n;
-    mpz_sqrt(sqrt_n.get_mpz_t(), n.get_mpz_t());
-    if (sqrt_n * sqrt_n == n)
-    {
-        cout << "Perfect square found: " << sqrt_n << endl;
-        final_factors.insert(sqrt_n);
-        final_factors.insert(sqrt_n);
-        print_factors_set(final_factors, start);
-        return EXIT_SUCCESS;
-    }
-
-    unsigned long B = smoothnessBound(n);
-    if (VERBOSE)
-    {
-        cout << "Smoothness bound B: " << B << endl;
-    }
-
-    // Generate the factor base
-    pair<vector<unsigned long>, vector<unsigned long>> factorBaseAndDividers = generateFactorBase(B, n);
-    vector<unsigned long> factorBase = factorBaseAndDividers.first;
-    vector<unsigned long> dividers = factorBaseAndDividers.second;
+    // Promt user for composite number n
+    string nStr;
+    cout << "Enter composite number n: ";
+    cin >> nStr;
 
-    if (dividers.size() > 0)
-    { // In case we found numbers with Legendre symbol 0
-        if (VERBOSE)
-        {
-            cout << "Found small prime factors: ";
-            for (unsigned long divider : dividers)
-            {
-                cout << divider << " ";
-            }
-            cout << endl;
-        }
+    auto start = chrono::high_resolution_clock::now();
 
-        // Add the small prime factors to the final factors
-        for (unsigned long divider : dividers)
+    for (char c : nStr)
+    { // Check if the input is a valid number
+        if (!isdigit(c))
         {
-            mpz_class prime_factor(divider);
-            final_factors.insert(prime_factor);
-            mpz_divexact_ui(n.get_mpz_t(), n.get_mpz_t(), divider);
+            cerr << "Error: Invalid input: '" << c << "'. Enter a valid composite number." << endl;
+            return EXIT_FAILURE;
         }
     }
 
-    if (VERBOSE)
-    {
-        cout << "Factor Base: ";
-        for (unsigned long prime : factorBase)
-        {
-            cout << prime << " ";
-        }
-        cout << endl;
+    if (nStr.length() > MAX_DIGITS)
+    { // Only proceed if the number of digits isn't too long
+        cerr << "Error: Number exceeds the maximum allowed digit limit of " << MAX_DIGITS << "." << endl;
+        return EXIT_FAILURE;
     }
 
-    // ceil
-    sqrt_n = isqrt(n);
-
     if (VERBOSE)
     {
-        cout << "Starting B-smooth search around x = " << sqrt_n << endl;
+        cout << string(60, '-') << endl;
     }
 
-    bool found_factor = false;
-    unsigned long sieve_interval = SIEVE_INTERVAL;
-    int attempt = 0;
-
-    // start searching for smooth relations at sqrt(n)
-    vector<Relation> relations;
-    mpz_class start_x = sqrt_n;
-
-    // while we haven't found a factor, keep searching by starting at a higher point and increasing the sieve interval
-    while (!found_factor)
-    {
-        attempt++;
-        if (VERBOSE)
-        {
-            cout << "\nAttempt " << attempt << " with sieve interval: " << sieve_interval << endl;
-            cout << "Starting search at x = " << start_x << endl;
-            cout << "Current relations count: " << relations.size() << endl;
-        }
-
-        relations = find_smooth_relations(n, factorBase, sieve_interval, relations, start_x);
-
-        if (VERBOSE)
-        {
-            cout << "Found " << relations.size() << " smooth relations so far." << endl;
-        }
-
-        // Check if we have enough relations to try finding dependencies (need at least pi(B))
-        if (relations.size() > factorBase.size())
-        {
-            vector<vector<int>> matrix;
-            for (const auto &rel : relations)
-                matrix.push_back(rel.exponents);
-
-            vector<vector<int>> dependencies;
-            if (!gaussian_elimination_all(matrix, dependencies))
-            {
-                cout << "No nontrivial dependency found; need more relations." << endl;
-                // We don't need to increase the sieve interval, just continue collecting more relations
-                continue;
-            }
-
-            cout << "\nFound " << dependencies.size() << " dependency vector(s)." << endl;
-
-            mpz_class factor;
-            bool found = false;
-            for (size_t k = 0; k < dependencies.size(); k++)
-            {
-                factor = solve_dependency(relations, dependencies[k], n);
-                if (factor != 1 && factor != n)
-                {
-                    found = true;
-                    found_factor = true;
-                    cout << "\nDependency vector " << k << " produced a nontrivial factor." << endl;
-
-                    mpz_class other_factor = n / factor;
-
-                    final_factors.insert(factor);
-                    final_factors.insert(other_factor);
-                    break;
-                }
-            }
-
-            if (!found)
-            {
-                cout << "\nNone of the dependency vectors produced a nontrivial factor." << endl;
-                // Continue collecting more relations - no need to increase interval
-            }
-        }
-        else
-        {
-            // If we don't have enough relations yet, continue collecting more
-            cout << "Need more relations. Currently have " << relations.size()
-                 << " of " << (factorBase.size() + 1) << " required." << endl;
-        }
+    mpz_class n(nStr); // n stores the composite number as a GMP integer to handle large numbers
 
-        // Increase the sieve interval after several attempts with no new relations (don't exceed MAX_SIEVE_INTERVAL as program may take too long)
-        if (attempt % 5 == 0 && relations.size() < factorBase.size() / 2 && sieve_interval < MAX_SIEVE_INTERVAL)
-        {
-            sieve_interval *= 10;
-            cout << "Increasing sieve interval to " << sieve_interval << endl;
-        }
-    }
+    Factorization factorization; // each prime factor with its multiplicity
+    Options options;
+    options.coordinator_port = coordinator_port;
+    options.telemetry_file = telemetry_file;
+    options.checkpoints = USE_CHECKPOINT; // the library leaves them off, calls would share CHECKPOINT_FILE
 
-    if (!found_factor)
+    string error;
+    if (!factorize(n, factorization, options, error))
     {
-        cerr << "Failed to find nontrivial factor after " << attempt << " attempts." << endl;
+        cerr << "Error: " << error << endl;
         return EXIT_FAILURE;
     }
 
-    print_factors_set(final_factors, start);
+    print_factorization(factorization, start);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+#include "parameters.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+static bool by_digits(const TunedParameters &a, const TunedParameters &b)
+{
+    return a.digits < b.digits;
+}
+
+bool load_parameter_table(const string &path, vector<TunedParameters> &table)
+{
+    ifstream input(path.c_str());
+    if (!input)
+        return false;
+
+    table.clear();
+    string line;
+    while (getline(input, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#')
+            continue;
+
+        TunedParameters entry;
+        istringstream fields(line);
+        if (fields >> entry.digits >> entry.smoothness_bound >> entry.sieve_interval >> entry.threshold_slack >>
+            entry.extra_relations)
+        {
+            table.push_back(entry);
+        }
+    }
+
+    sort(table.begin(), table.end(), by_digits);
+    return !table.empty();
+}
+
+bool write_parameter_table(const string &path, vector<TunedParameters> table)
+{
+    ofstream output(path.c_str());
+    if (!output)
+        return false;
+
+    sort(table.begin(), table.end(), by_digits);
+    output << "# digits smoothness_bound sieve_interval threshold_slack extra_relations" << endl;
+    for (const TunedParameters &entry : table)
+    {
+        output << entry.digits << " " << entry.smoothness_bound << " " << entry.sieve_interval << " "
+               << entry.threshold_slack << " " << entry.extra_relations << endl;
+    }
+    return static_cast<bool>(output);
+}
+
+// a^(1 - t) * b^t, the bounds grow roughly exponentially with the number of digits
+static unsigned long geometric(unsigned long a, unsigned long b, double t)
+{
+    return static_cast<unsigned long>(round(exp((1 - t) * log(static_cast<double>(a)) + t * log(static_cast<double>(b)))));
+}
+
+TunedParameters lookup_parameters(const vector<TunedParameters> &table, unsigned int digits)
+{
+    // First entry for at least this many digits
+    size_t hi = 0;
+    while (hi < table.size() && table[hi].digits < digits)
+        hi++;
+
+    if (hi == table.size())
+        return table.back();
+    if (hi == 0 || table[hi].digits == digits)
+        return table[hi];
+
+    const TunedParameters &a = table[hi - 1];
+    const TunedParameters &b = table[hi];
+    double t = static_cast<double>(digits - a.digits) / (b.digits - a.digits);
+
+    TunedParameters entry;
+    entry.digits = digits;
+    entry.smoothness_bound = geometric(a.smoothness_bound, b.smoothness_bound, t);
+    entry.sieve_interval = geometric(a.sieve_interval, b.sieve_interval, t);
+    entry.threshold_slack = (1 - t) * a.threshold_slack + t * b.threshold_slack;
+    entry.extra_relations = static_cast<size_t>(round((1 - t) * a.extra_relations + t * b.extra_relations));
+    return entry;
+}
@@ -0,0 +1,30 @@
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Sieve parameters measured to work best for numbers of one size, as found by --autotune
+struct TunedParameters
+{
+    unsigned int digits;            // size of the numbers they were tuned on
+    unsigned long smoothness_bound; // factor base bound B
+    unsigned long sieve_interval;   // sieve interval (per polynomial with SIQS)
+    double threshold_slack;         // sieve threshold slack in multiples of log2 of the largest prime
+    size_t extra_relations;         // relations to collect beyond the size of the factor base
+};
+
+// Reads a parameter table, one line per digit count:
+//   <digits> <smoothness bound> <sieve interval> <threshold slack> <extra relations>
+// with blank lines and lines starting with # skipped. Returns false if the file can't be read or has no entries
+bool load_parameter_table(const std::string &path, std::vector<TunedParameters> &table);
+
+// Writes the table in the format read by load_parameter_table, sorted by digits
+bool write_parameter_table(const std::string &path, std::vector<TunedParameters> table);
+
+// Parameters for a number of the given size: an entry of the table, or geometric (B and sieve interval)
+// and linear (slack and extra relations) interpolation between the two entries around it, clamped at the ends
+TunedParameters lookup_parameters(const std::vector<TunedParameters> &table, unsigned int digits);
+
+#endif // PARAMETERS_H
@@ -1,8 +1,10 @@
 #include "probable_prime.h"
 
 
-bool isProbablePrime(const mpz_class &n, int reps) {
-    if (n <= 2) return false;
+bool isProbablePrime(const mpz_class &n, int reps, gmp_randclass &rng) {
+    if (n < 2) return false;
+    if (n < 4) return true;
+    if (n % 2 == 0) return false;
 
     mpz_class d = n - 1;
     int s = 0;
@@ -15,7 +17,7 @@ bool isProbablePrime(const mpz_class &n, int reps) {
 
     for (int i = 0; i < reps; i++) {
         // Pick a random base in the range [2, n - 2]
-        mpz_class a = rand() % (n - 4) + 2;
+        mpz_class a = rng.get_z_range(n - 3) + 2;
         mpz_class x;
         mpz_powm(x.get_mpz_t(), a.get_mpz_t(), d.get_mpz_t(), n.get_mpz_t());
 
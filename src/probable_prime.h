@@ -3,7 +3,7 @@
 
 #include <gmpxx.h>
 
-// Checks if n is a strong probable prime using the Miller-Rabin test
-bool isProbablePrime(const mpz_class &n, int reps);
+// Checks if n is a strong probable prime using the Miller-Rabin test, with random bases drawn from rng
+bool isProbablePrime(const mpz_class &n, int reps, gmp_randclass &rng);
 
 #endif // PROBABLE_PRIME_H
\ No newline at end of file
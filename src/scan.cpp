@@ -0,0 +1,157 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#else
+#define SCAN_X86 0
+#endif
+
+using namespace std;
+
+static void scan_scalar(const unsigned char *data,
+                        size_t len,
+                        unsigned char threshold,
+                        unsigned long offset,
+                        vector<unsigned long> &positions)
+{
+    for (size_t j = 0; j < len; j++)
+    {
+        if (data[j] >= threshold)
+            positions.push_back(offset + j);
+    }
+}
+
+#if SCAN_X86
+// The vector kernels are compiled for their instruction set only, so the rest of the program runs on any x86 CPU.
+// Unsigned bytes have no >= compare before AVX-512, but max(b, t) == b exactly when b >= t
+
+__attribute__((target("sse2"))) static void scan_sse2(const unsigned char *data,
+                                                       size_t len,
+                                                       unsigned char threshold,
+                                                       unsigned long offset,
+                                                       vector<unsigned long> &positions)
+{
+    const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+    size_t j = 0;
+    for (; j + 16 <= len; j += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + j));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v));
+        for (; mask != 0; mask &= mask - 1)
+            positions.push_back(offset + j + __builtin_ctz(mask));
+    }
+    scan_scalar(data + j, len - j, threshold, offset + j, positions);
+}
+
+__attribute__((target("avx2"))) static void scan_avx2(const unsigned char *data,
+                                                      size_t len,
+                                                      unsigned char threshold,
+                                                      unsigned long offset,
+                                                      vector<unsigned long> &positions)
+{
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(threshold));
+    size_t j = 0;
+    for (; j + 32 <= len; j += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + j));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v));
+        for (; mask != 0; mask &= mask - 1)
+            positions.push_back(offset + j + __builtin_ctz(mask));
+    }
+    scan_scalar(data + j, len - j, threshold, offset + j, positions);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void scan_avx512(const unsigned char *data,
+                                                                    size_t len,
+                                                                    unsigned char threshold,
+                                                                    unsigned long offset,
+                                                                    vector<unsigned long> &positions)
+{
+    const __m512i t = _mm512_set1_epi8(static_cast<char>(threshold));
+    size_t j = 0;
+    for (; j + 64 <= len; j += 64)
+    {
+        __m512i v = _mm512_loadu_si512(data + j);
+        unsigned long long mask = _mm512_cmpge_epu8_mask(v, t);
+        for (; mask != 0; mask &= mask - 1)
+            positions.push_back(offset + j + __builtin_ctzll(mask));
+    }
+    scan_scalar(data + j, len - j, threshold, offset + j, positions);
+}
+#endif
+
+const char *scan_kernel_name(ScanKernel kernel)
+{
+    switch (kernel)
+    {
+    case SCAN_SSE2:
+        return "sse2";
+    case SCAN_AVX2:
+        return "avx2";
+    case SCAN_AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+bool scan_kernel_supported(ScanKernel kernel)
+{
+#if SCAN_X86
+    switch (kernel)
+    {
+    case SCAN_SCALAR:
+        return true;
+    case SCAN_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SCAN_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SCAN_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    default:
+        return false;
+    }
+#else
+    return kernel == SCAN_SCALAR;
+#endif
+}
+
+ScanKernel best_scan_kernel()
+{
+    static const ScanKernel best = []() {
+        ScanKernel kernel = SCAN_SCALAR;
+        for (int k = SCAN_SCALAR; k < SCAN_KERNELS; k++)
+        {
+            if (scan_kernel_supported(static_cast<ScanKernel>(k)))
+                kernel = static_cast<ScanKernel>(k);
+        }
+        return kernel;
+    }();
+    return best;
+}
+
+void scan_bytes(ScanKernel kernel,
+                const unsigned char *data,
+                size_t len,
+                unsigned char threshold,
+                unsigned long offset,
+                vector<unsigned long> &positions)
+{
+    switch (kernel)
+    {
+#if SCAN_X86
+    case SCAN_SSE2:
+        scan_sse2(data, len, threshold, offset, positions);
+        return;
+    case SCAN_AVX2:
+        scan_avx2(data, len, threshold, offset, positions);
+        return;
+    case SCAN_AVX512:
+        scan_avx512(data, len, threshold, offset, positions);
+        return;
+#endif
+    default:
+        scan_scalar(data, len, threshold, offset, positions);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <vector>
+
+// Ways of finding the sieve positions that reach the threshold, from one byte at a time to 64
+enum ScanKernel
+{
+    SCAN_SCALAR,
+    SCAN_SSE2,   // 16 bytes per compare
+    SCAN_AVX2,   // 32 bytes per compare
+    SCAN_AVX512, // 64 bytes per compare (AVX-512BW)
+    SCAN_KERNELS
+};
+
+// Short name of a kernel, for output
+const char *scan_kernel_name(ScanKernel kernel);
+
+// True if this build and the CPU it runs on can use the kernel (the vector ones are only built for x86)
+bool scan_kernel_supported(ScanKernel kernel);
+
+// Widest kernel the CPU supports, detected on the first call
+ScanKernel best_scan_kernel();
+
+// Appends offset + j for each j < len with data[j] >= threshold, in increasing order. Most of the data is below
+// the threshold, so the vector kernels compare a whole register at once and only look at single bytes when one passes
+void scan_bytes(ScanKernel kernel,
+                const unsigned char *data,
+                size_t len,
+                unsigned char threshold,
+                unsigned long offset,
+                std::vector<unsigned long> &positions);
+
+#endif // SCAN_H
@@ -0,0 +1,116 @@
+#include "serialize.h"
+#include <cstring>
+
+using namespace std;
+
+void put_u8(vector<unsigned char> &buf, uint8_t v)
+{
+    buf.push_back(v);
+}
+
+void put_u32(vector<unsigned char> &buf, uint32_t v)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+    buf.insert(buf.end(), bytes, bytes + sizeof(v));
+}
+
+void put_u64(vector<unsigned char> &buf, uint64_t v)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+    buf.insert(buf.end(), bytes, bytes + sizeof(v));
+}
+
+void put_f64(vector<unsigned char> &buf, double v)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+    buf.insert(buf.end(), bytes, bytes + sizeof(v));
+}
+
+void put_mpz(vector<unsigned char> &buf, const mpz_class &x)
+{
+    size_t count = 0;
+    vector<unsigned char> bytes(mpz_sizeinbase(x.get_mpz_t(), 256));
+    mpz_export(&bytes[0], &count, 1, 1, 1, 0, x.get_mpz_t());
+    put_u32(buf, count);
+    buf.insert(buf.end(), bytes.begin(), bytes.begin() + count);
+}
+
+void put_relation(vector<unsigned char> &buf, const Relation &rel)
+{
+    put_mpz(buf, rel.x);
+    put_u32(buf, rel.factors.size());
+    for (const pair<unsigned int, unsigned int> &f : rel.factors)
+    {
+        put_u32(buf, f.first);
+        put_u32(buf, f.second);
+    }
+    put_u32(buf, rel.large_primes.size());
+    for (unsigned long prime : rel.large_primes)
+        put_u64(buf, prime);
+}
+
+bool ByteReader::bytes(void *out, size_t count)
+{
+    if (static_cast<size_t>(end - pos) < count)
+        return false;
+    memcpy(out, pos, count);
+    pos += count;
+    return true;
+}
+
+bool ByteReader::u8(uint8_t &v)
+{
+    return bytes(&v, sizeof(v));
+}
+
+bool ByteReader::u32(uint32_t &v)
+{
+    return bytes(&v, sizeof(v));
+}
+
+bool ByteReader::u64(uint64_t &v)
+{
+    return bytes(&v, sizeof(v));
+}
+
+bool ByteReader::f64(double &v)
+{
+    return bytes(&v, sizeof(v));
+}
+
+bool ByteReader::mpz(mpz_class &x)
+{
+    uint32_t count;
+    if (!u32(count) || static_cast<size_t>(end - pos) < count)
+        return false;
+    mpz_import(x.get_mpz_t(), count, 1, 1, 1, 0, pos);
+    pos += count;
+    return true;
+}
+
+bool ByteReader::relation(Relation &rel)
+{
+    uint32_t count, large_count;
+    if (!mpz(rel.x) || !u32(count) || static_cast<size_t>(end - pos) / 8 < count)
+        return false;
+    rel.factors.resize(count);
+    for (uint32_t k = 0; k < count; k++)
+    {
+        uint32_t column, exponent;
+        if (!u32(column) || !u32(exponent))
+            return false;
+        rel.factors[k] = make_pair(column, exponent);
+    }
+    // Relations combined from cycles carry the large primes of every edge, so there can be more than 255
+    if (!u32(large_count) || static_cast<size_t>(end - pos) / 8 < large_count)
+        return false;
+    rel.large_primes.resize(large_count);
+    for (uint32_t k = 0; k < large_count; k++)
+    {
+        uint64_t prime;
+        if (!u64(prime))
+            return false;
+        rel.large_primes[k] = prime;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <gmpxx.h>
+#include <cstdint>
+#include <vector>
+#include "smooth_relations.h"
+
+// Compact binary encoding shared by the relation file and the distributed sieving protocol.
+// Integers and doubles are written in native byte order, multiprecision values as a byte count and big-endian bytes
+void put_u8(std::vector<unsigned char> &buf, uint8_t v);
+void put_u32(std::vector<unsigned char> &buf, uint32_t v);
+void put_u64(std::vector<unsigned char> &buf, uint64_t v);
+void put_f64(std::vector<unsigned char> &buf, double v);
+void put_mpz(std::vector<unsigned char> &buf, const mpz_class &x); // x must be non-negative
+void put_relation(std::vector<unsigned char> &buf, const Relation &rel);
+
+// Bounds-checked reads, failing once the data runs out (e.g. a record cut short by a crash)
+struct ByteReader
+{
+    const unsigned char *pos;
+    const unsigned char *end;
+
+    bool bytes(void *out, size_t count);
+    bool u8(uint8_t &v);
+    bool u32(uint32_t &v);
+    bool u64(uint64_t &v);
+    bool f64(double &v);
+    bool mpz(mpz_class &x);
+    bool relation(Relation &rel);
+};
+
+#endif // SERIALIZE_H
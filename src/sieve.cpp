@@ -0,0 +1,266 @@
+#include "sieve.h"
+#include "config.h"
+#include "scan.h"
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+unsigned char scaled_log2(double x)
+{
+    double l = round(log2(x));
+    if (l < 0)
+        return 0;
+    if (l > 255)
+        return 255;
+    return static_cast<unsigned char>(l);
+}
+
+void SieveStats::add(const SieveStats &other)
+{
+    positions += other.positions;
+    candidates += other.candidates;
+    smooth += other.smooth;
+    partial += other.partial;
+    rejected += other.rejected;
+    sampled += other.sampled;
+    missed += other.missed;
+    trial_divisions += other.trial_divisions;
+    sieve_seconds += other.sieve_seconds;
+    scan_seconds += other.scan_seconds;
+    resieve_seconds += other.resieve_seconds;
+    trial_seconds += other.trial_seconds;
+}
+
+double lap_seconds(chrono::steady_clock::time_point &start)
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - start).count();
+    start = now;
+    return seconds;
+}
+
+void print_sieve_stats(const SieveStats &stats)
+{
+    if (stats.candidates == 0)
+        return;
+
+    cout << "Sieve: " << stats.candidates << " of " << stats.positions << " positions checked, "
+         << fixed << setprecision(1) << 100.0 * stats.rejected / stats.candidates << "% false positives";
+    if (stats.sampled > 0)
+    {
+        // Every sampled position stands for SIEVE_STATS_SAMPLE positions below the threshold
+        double below = static_cast<double>(stats.positions - stats.candidates);
+        cout << ", " << stats.missed << " of " << stats.sampled << " sampled positions below the threshold were relations"
+             << " (about " << static_cast<unsigned long>(stats.missed * below / stats.sampled) << " missed)";
+    }
+    cout << defaultfloat << "." << endl;
+}
+
+size_t small_prime_end(const vector<unsigned long> &primes)
+{
+    return lower_bound(primes.begin(), primes.end(), static_cast<unsigned long>(SMALL_PRIME_CUTOFF)) - primes.begin();
+}
+
+double skipped_primes_log2(const vector<unsigned long> &primes,
+                           const vector<unsigned long> &root1,
+                           const vector<unsigned long> &root2,
+                           size_t end)
+{
+    double expected = 0;
+    for (size_t i = 0; i < end; i++)
+    {
+        double roots = (root1[i] == root2[i]) ? 1 : 2;
+        expected += roots * log2(static_cast<double>(primes[i])) / (primes[i] - 1);
+    }
+    return expected;
+}
+
+size_t bucket_sieve_start(const vector<unsigned long> &primes)
+{
+    return lower_bound(primes.begin(), primes.end(), static_cast<unsigned long>(BUCKET_SIEVE_MIN_PRIME)) - primes.begin();
+}
+
+void fill_buckets(unsigned long begin,
+                  unsigned long end,
+                  size_t first,
+                  const vector<unsigned long> &primes,
+                  const vector<unsigned char> &logs,
+                  const vector<unsigned long> &root1,
+                  const vector<unsigned long> &root2,
+                  vector<vector<BucketHit>> &buckets)
+{
+    buckets.resize((end - begin + SIEVE_BLOCK_SIZE - 1) / SIEVE_BLOCK_SIZE);
+    for (vector<BucketHit> &bucket : buckets)
+        bucket.clear();
+
+    for (size_t i = first; i < primes.size(); i++)
+    {
+        if (logs[i] == 0)
+            continue;
+
+        unsigned long p = primes[i];
+        BucketHit hit;
+        hit.prime = i;
+        for (int r = 0; r < 2; r++)
+        {
+            unsigned long root = r ? root2[i] : root1[i];
+            if (r && root == root1[i])
+                break;
+
+            // First hit at or after begin
+            unsigned long j = root >= begin ? root : root + (begin - root + p - 1) / p * p;
+            for (; j < end; j += p)
+            {
+                hit.position = j % SIEVE_BLOCK_SIZE;
+                buckets[(j - begin) / SIEVE_BLOCK_SIZE].push_back(hit);
+            }
+        }
+    }
+}
+
+void sieve_block(vector<unsigned char> &block,
+                 unsigned long block_start,
+                 const vector<unsigned long> &primes,
+                 const vector<unsigned char> &logs,
+                 const vector<unsigned long> &root1,
+                 const vector<unsigned long> &root2,
+                 size_t begin,
+                 size_t end,
+                 const vector<BucketHit> &bucket)
+{
+    unsigned long len = block.size();
+    unsigned char *sieve = block.data();
+    fill(block.begin(), block.end(), 0);
+
+    for (size_t i = begin; i < end; i++)
+    {
+        unsigned char log_p = logs[i];
+        if (log_p == 0)
+            continue;
+
+        unsigned long p = primes[i];
+        unsigned long shift = block_start % p;
+
+        // First position inside this block for each root
+        unsigned long j1 = (root1[i] >= shift) ? root1[i] - shift : root1[i] + p - shift;
+        unsigned long j2 = (root2[i] >= shift) ? root2[i] - shift : root2[i] + p - shift;
+
+        if (j1 == j2)
+        { // Only one root (p = 2 or p divides the leading coefficient)
+            for (; j1 < len; j1 += p)
+                sieve[j1] += log_p;
+            continue;
+        }
+
+        // Both roots step by p, so walk them together while both are inside the block
+        if (j1 > j2)
+            swap(j1, j2);
+        for (; j2 < len; j1 += p, j2 += p)
+        {
+            sieve[j1] += log_p;
+            sieve[j2] += log_p;
+        }
+        if (j1 < len)
+            sieve[j1] += log_p;
+    }
+
+    // The large primes have already been sorted into this block's hits
+    for (const BucketHit &hit : bucket)
+        sieve[hit.position] += logs[hit.prime];
+}
+
+void scan_block(const vector<unsigned char> &block,
+                unsigned long block_start,
+                unsigned char threshold,
+                vector<unsigned long> &candidates)
+{
+    scan_bytes(best_scan_kernel(), block.data(), block.size(), threshold, block_start, candidates);
+}
+
+void sample_block(const vector<unsigned char> &block,
+                  unsigned long block_start,
+                  unsigned char threshold,
+                  vector<unsigned long> &candidates)
+{
+    unsigned long first = (SIEVE_STATS_SAMPLE - block_start % SIEVE_STATS_SAMPLE) % SIEVE_STATS_SAMPLE;
+    for (unsigned long j = first; j < block.size(); j += SIEVE_STATS_SAMPLE)
+    {
+        if (block[j] < threshold)
+            candidates.push_back(block_start + j);
+    }
+}
+
+void resieve_block(unsigned long block_len,
+                   unsigned long block_start,
+                   const vector<unsigned long> &primes,
+                   const vector<unsigned char> &logs,
+                   const vector<unsigned long> &root1,
+                   const vector<unsigned long> &root2,
+                   size_t end,
+                   const vector<BucketHit> &bucket,
+                   const vector<unsigned long> &candidates,
+                   vector<vector<unsigned int>> &divisors,
+                   vector<unsigned int> &slots)
+{
+    divisors.resize(candidates.size());
+    for (vector<unsigned int> &d : divisors)
+        d.clear();
+    if (candidates.empty())
+        return;
+
+    // Slot c + 1 marks the position of candidate c, 0 is any other position
+    if (slots.size() < block_len)
+        slots.resize(block_len, 0);
+    for (size_t c = 0; c < candidates.size(); c++)
+        slots[candidates[c] - block_start] = c + 1;
+
+    // Walking a prime costs about 2 * block_len / p steps and testing it costs one division per candidate
+    unsigned long walk_from = 2 * block_len / candidates.size();
+
+    for (size_t i = 0; i < end; i++)
+    {
+        if (logs[i] == 0)
+            continue;
+
+        unsigned long p = primes[i];
+        if (p <= walk_from)
+        {
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                unsigned long r = candidates[c] % p;
+                if (r == root1[i] || r == root2[i])
+                    divisors[c].push_back(i);
+            }
+            continue;
+        }
+
+        unsigned long shift = block_start % p;
+        unsigned long j1 = (root1[i] >= shift) ? root1[i] - shift : root1[i] + p - shift;
+        unsigned long j2 = (root2[i] >= shift) ? root2[i] - shift : root2[i] + p - shift;
+        for (; j1 < block_len; j1 += p)
+        {
+            if (slots[j1])
+                divisors[slots[j1] - 1].push_back(i);
+        }
+        if (root1[i] == root2[i])
+            continue;
+        for (; j2 < block_len; j2 += p)
+        {
+            if (slots[j2])
+                divisors[slots[j2] - 1].push_back(i);
+        }
+    }
+
+    // Bucket hits come in increasing order of prime, after all the primes below end
+    for (const BucketHit &hit : bucket)
+    {
+        if (slots[hit.position])
+            divisors[slots[hit.position] - 1].push_back(hit.prime);
+    }
+
+    for (unsigned long j : candidates)
+        slots[j - block_start] = 0;
+}
@@ -0,0 +1,118 @@
+#ifndef SIEVE_H
+#define SIEVE_H
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Base-2 logarithm rounded to the nearest integer so that sieve values fit in a byte
+unsigned char scaled_log2(double x);
+
+// Counts used to tune the sieve threshold and to see where the sieving time goes. Each thread keeps its own
+// and adds them to the shared ones when it is done, so counting costs no synchronisation
+struct SieveStats
+{
+    unsigned long positions;       // sieve positions scanned
+    unsigned long candidates;      // positions reaching the threshold and checked by trial division
+    unsigned long smooth;          // candidates giving a full relation
+    unsigned long partial;         // candidates giving a partial relation
+    unsigned long rejected;        // candidates that gave neither a full nor a partial relation (false positives)
+    unsigned long sampled;         // positions below the threshold checked anyway (only with SIEVE_THRESHOLD_STATS)
+    unsigned long missed;          // sampled positions that gave a relation (false negatives)
+    unsigned long trial_divisions; // divisibility tests of candidates by factor base primes
+    double sieve_seconds;          // adding the logs of the primes to the blocks
+    double scan_seconds;           // comparing the blocks against the threshold
+    double resieve_seconds;        // finding the primes dividing each candidate
+    double trial_seconds;          // trial division and splitting the cofactors of the candidates
+
+    SieveStats()
+        : positions(0), candidates(0), smooth(0), partial(0), rejected(0), sampled(0), missed(0), trial_divisions(0),
+          sieve_seconds(0), scan_seconds(0), resieve_seconds(0), trial_seconds(0) {}
+    void add(const SieveStats &other);
+};
+
+// Seconds from start to now, moving start to now so consecutive steps can be timed one after the other
+double lap_seconds(std::chrono::steady_clock::time_point &start);
+
+// Prints the false positive rate and the estimated number of relations lost below the threshold
+void print_sieve_stats(const SieveStats &stats);
+
+// Index of the first factor base prime that is sieved, the smaller ones are only found by trial division
+size_t small_prime_end(const std::vector<unsigned long> &primes);
+
+// Expected base-2 log of the part of Q(x) made of the primes below index end (and their powers),
+// which are not sieved: a prime with r roots contributes r * log2(p) / (p - 1) on average
+double skipped_primes_log2(const std::vector<unsigned long> &primes,
+                           const std::vector<unsigned long> &root1,
+                           const std::vector<unsigned long> &root2,
+                           size_t end);
+
+// One hit of a large factor base prime in a block
+struct BucketHit
+{
+    unsigned int position; // position inside the block
+    unsigned int prime;    // factor base index of the prime
+};
+
+// Index of the first factor base prime sieved through buckets (primes.size() if there are none)
+size_t bucket_sieve_start(const std::vector<unsigned long> &primes);
+
+// Walks every root of the primes from index first over the positions [begin, end) of the interval in a single
+// pass and appends each hit to the bucket of its block (bucket 0 for the block at begin, a multiple of
+// SIEVE_BLOCK_SIZE), in increasing order of prime index. Primes with a log of 0 are skipped.
+void fill_buckets(unsigned long begin,
+                  unsigned long end,
+                  size_t first,
+                  const std::vector<unsigned long> &primes,
+                  const std::vector<unsigned char> &logs,
+                  const std::vector<unsigned long> &root1,
+                  const std::vector<unsigned long> &root2,
+                  std::vector<std::vector<BucketHit>> &buckets);
+
+// Adds the scaled logarithm of each factor base prime to one block of the sieve interval.
+// The block covers positions [block_start, block_start + block.size()) of the interval,
+// root1[i] and root2[i] are the first positions of the interval (in [0, p)) where p divides Q(x).
+// Only the primes with index in [begin, end) are walked, the hits of larger ones are applied from the block's
+// bucket and smaller ones are left out. Primes with a log of 0 are not sieved.
+void sieve_block(std::vector<unsigned char> &block,
+                 unsigned long block_start,
+                 const std::vector<unsigned long> &primes,
+                 const std::vector<unsigned char> &logs,
+                 const std::vector<unsigned long> &root1,
+                 const std::vector<unsigned long> &root2,
+                 size_t begin,
+                 size_t end,
+                 const std::vector<BucketHit> &bucket);
+
+// Appends the positions (relative to the interval) of the block whose value reaches the threshold,
+// with the widest vector compare the CPU has (scan.h)
+void scan_block(const std::vector<unsigned char> &block,
+                unsigned long block_start,
+                unsigned char threshold,
+                std::vector<unsigned long> &candidates);
+
+// With SIEVE_THRESHOLD_STATS, appends every SIEVE_STATS_SAMPLE-th position of the interval that is below
+// the threshold, so it can be checked like a candidate
+void sample_block(const std::vector<unsigned char> &block,
+                  unsigned long block_start,
+                  unsigned char threshold,
+                  std::vector<unsigned long> &candidates);
+
+// Finds the factor base primes dividing Q at each candidate of the block, so that trial division only
+// tries those. divisors[c] gets the indices (ascending) of the primes whose roots hit candidates[c].
+// Primes large enough to have few hits in the block are resieved, walking their roots again and looking
+// the positions up in slots (a zeroed work array kept by the caller), smaller ones are tested per candidate.
+// Primes from index end are read from the block's bucket instead
+void resieve_block(unsigned long block_len,
+                   unsigned long block_start,
+                   const std::vector<unsigned long> &primes,
+                   const std::vector<unsigned char> &logs,
+                   const std::vector<unsigned long> &root1,
+                   const std::vector<unsigned long> &root2,
+                   size_t end,
+                   const std::vector<BucketHit> &bucket,
+                   const std::vector<unsigned long> &candidates,
+                   std::vector<std::vector<unsigned int>> &divisors,
+                   std::vector<unsigned int> &slots);
+
+#endif // SIEVE_H
@@ -0,0 +1,574 @@
+#include "siqs.h"
+#include "sieve.h"
+#include "large_prime.h"
+#include "verbose.h"
+#include <omp.h>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+// Modular inverse of a mod m using the extended Euclidean algorithm (a and m coprime)
+static unsigned long mod_inverse(unsigned long a, unsigned long m)
+{
+    long long old_r = a % m, r = m;
+    long long old_s = 1, s = 0;
+    while (r != 0)
+    {
+        long long q = old_r / r;
+        long long tmp = old_r - q * r;
+        old_r = r;
+        r = tmp;
+        tmp = old_s - q * s;
+        old_s = s;
+        s = tmp;
+    }
+    if (old_s < 0)
+        old_s += m;
+    return static_cast<unsigned long>(old_s);
+}
+
+// Chooses a new coefficient a = q_0 * ... * q_{s-1} close to sqrt(2N) / M,
+// then computes the B_l terms, the first b and the sieve roots for every factor base prime
+static bool new_polynomial_a(const mpz_class &N,
+                             const FactorBase &factor_base,
+                             unsigned long M,
+                             SiqsState &state)
+{
+    size_t fb_size = factor_base.size();
+
+    // With a ~ sqrt(2N) / M the values of Q(x) / a are bounded by M * sqrt(N / 2) over [-M, M)
+    mpz_class target;
+    mpz_class two_n = 2 * N;
+    mpz_sqrt(target.get_mpz_t(), two_n.get_mpz_t());
+    target /= M;
+    double log_target = log(target.get_d());
+
+    // Number of primes s so that each one is around SIQS_A_PRIME_SIZE (or half the largest factor base prime)
+    double log_q = log(min(static_cast<double>(SIQS_A_PRIME_SIZE), factor_base.primes.back() / 2.0));
+    size_t s = static_cast<size_t>(round(log_target / log_q));
+    if (s < 1)
+        s = 1;
+    double log_each = log_target / s;
+
+    // Pool of candidate primes around the ideal size, widened until there is enough choice
+    vector<size_t> pool;
+    for (double width = 0.5; pool.size() < s + 4 && width < 8; width *= 2)
+    {
+        pool.clear();
+        for (size_t i = 0; i < fb_size; i++)
+        {
+            unsigned long p = factor_base.primes[i];
+            if (p > 2 && fabs(log(static_cast<double>(p)) - log_each) < width)
+            {
+                pool.push_back(i);
+            }
+        }
+    }
+    if (pool.size() < s)
+        return false;
+
+    // Pick s - 1 primes at random and the last one so that a is as close as possible to the target
+    mpz_class best_a = 0;
+    vector<size_t> best_factors;
+    double best_score = 0;
+
+    for (int attempt = 0; attempt < SIQS_A_TRIES; attempt++)
+    {
+        vector<size_t> chosen;
+        mpz_class product = 1;
+        while (chosen.size() < s - 1)
+        {
+            size_t idx = pool[state.rng() % pool.size()];
+            if (find(chosen.begin(), chosen.end(), idx) == chosen.end())
+            {
+                chosen.push_back(idx);
+                product *= factor_base.primes[idx];
+            }
+        }
+
+        for (size_t idx : pool)
+        {
+            if (find(chosen.begin(), chosen.end(), idx) != chosen.end())
+                continue;
+
+            mpz_class a = product * factor_base.primes[idx];
+            double score = fabs(log(a.get_d()) - log_target);
+            if ((best_a == 0 || score < best_score) && state.used_a.find(a) == state.used_a.end())
+            {
+                best_a = a;
+                best_score = score;
+                best_factors = chosen;
+                best_factors.push_back(idx);
+            }
+        }
+    }
+
+    if (best_a == 0)
+        return false;
+
+    state.a = best_a;
+    state.a_factors = best_factors;
+    state.used_a.insert(best_a);
+
+    // Primes dividing a have a single root, skip them when sieving (trial division still finds them)
+    state.divides_a.assign(fb_size, false);
+    state.sieve_logs = factor_base.logs;
+    for (size_t idx : state.a_factors)
+    {
+        state.divides_a[idx] = true;
+        state.sieve_logs[idx] = 0;
+    }
+
+    // B_l = (a / q_l) * gamma with gamma = t_l * (a / q_l)^-1 mod q_l, so that B_l^2 = N mod q_l
+    state.B_terms.assign(s, 0);
+    state.B_signs.assign(s, 1);
+    state.b = 0;
+    for (size_t l = 0; l < s; l++)
+    {
+        unsigned long q = factor_base.primes[state.a_factors[l]];
+        mpz_class a_div_q = state.a / q;
+        unsigned long inv = mod_inverse(mpz_fdiv_ui(a_div_q.get_mpz_t(), q), q);
+        unsigned long gamma = (factor_base.root1[state.a_factors[l]] * inv) % q;
+        if (gamma > q / 2)
+            gamma = q - gamma;
+        state.B_terms[l] = a_div_q * gamma;
+        state.b += state.B_terms[l];
+    }
+
+    // Roots of (a*x + b)^2 = N mod p are x = a^-1 * (+-t - b) mod p
+    state.soln1.assign(fb_size, 0);
+    state.soln2.assign(fb_size, 0);
+    state.Bainv2.assign(s, vector<unsigned long>(fb_size, 0));
+
+#pragma omp parallel for
+    for (size_t i = 0; i < fb_size; i++)
+    {
+        if (state.divides_a[i])
+            continue;
+
+        unsigned long p = factor_base.primes[i];
+        unsigned long t = factor_base.root1[i];
+        unsigned long a_inv = mod_inverse(mpz_fdiv_ui(state.a.get_mpz_t(), p), p);
+        unsigned long b_mod = mpz_fdiv_ui(state.b.get_mpz_t(), p);
+
+        state.soln1[i] = (a_inv * ((t + p - b_mod) % p)) % p;
+        state.soln2[i] = (a_inv * ((2 * p - t - b_mod) % p)) % p;
+
+        for (size_t l = 0; l < s; l++)
+        {
+            unsigned long B_mod = mpz_fdiv_ui(state.B_terms[l].get_mpz_t(), p);
+            state.Bainv2[l][i] = (((2 * B_mod) % p) * a_inv) % p;
+        }
+    }
+
+    state.b_index = 0;
+    state.b_count = 1UL << (s - 1);
+
+    return true;
+}
+
+// Switches to the next b with a Gray code: only one B_l changes sign, so every root moves by +-Bainv2[l]
+static void next_polynomial_b(const FactorBase &factor_base, SiqsState &state)
+{
+    // The lowest set bit of the index picks the term to flip (B_0 never flips so b and -b aren't both used)
+    size_t v = __builtin_ctzl(state.b_index) + 1;
+    int sign = state.B_signs[v];
+
+    state.b -= 2 * sign * state.B_terms[v];
+    state.B_signs[v] = -sign;
+
+    const vector<unsigned long> &delta = state.Bainv2[v];
+
+#pragma omp parallel for
+    for (size_t i = 0; i < factor_base.size(); i++)
+    {
+        if (state.divides_a[i])
+            continue;
+
+        unsigned long p = factor_base.primes[i];
+        unsigned long d = (sign > 0) ? delta[i] : p - delta[i];
+        state.soln1[i] = (state.soln1[i] + d) % p;
+        state.soln2[i] = (state.soln2[i] + d) % p;
+    }
+}
+
+// One polynomial copied out of SiqsState with its sieve roots and bucket hits, so that the polynomials of a batch
+// can be sieved side by side while the state moves on
+struct SiqsPolynomial
+{
+    mpz_class a;
+    mpz_class b;
+    vector<size_t> a_factors;           // factor base indices of the primes dividing a
+    vector<unsigned char> sieve_logs;   // factor base logs, 0 for the primes dividing a
+    vector<unsigned long> start1;       // first sieve position of each root, position j is x = j - M
+    vector<unsigned long> start2;
+    vector<vector<BucketHit>> buckets;  // hits of the large primes in each block
+};
+
+// Checks a sieve candidate by trial division and builds its relation if (a*x + b)^2 - N is B-smooth
+// apart from at most two large primes, which are returned (1 when absent). Only the primes dividing a
+// and the divisors found by resieving are tried
+static bool siqs_relation(const mpz_class &N,
+                          const FactorBase &factor_base,
+                          const SiqsPolynomial &poly,
+                          long x,
+                          const vector<unsigned int> &divisors,
+                          unsigned long large_bound,
+                          unsigned long double_bound,
+                          Relation &rel,
+                          unsigned long &large_prime1,
+                          unsigned long &large_prime2,
+                          unsigned long &trial_divisions)
+{
+    // (a*x + b)^2 - N, which includes the factors of a
+    mpz_class X = poly.a * x + poly.b;
+    mpz_class Q = X * X - N;
+
+    // Record the full exponents while checking smoothness by trial division
+    rel.factors.clear();
+    rel.large_primes.clear();
+    if (Q < 0)
+        rel.factors.push_back(make_pair(0u, 1u));
+
+    vector<unsigned int> known(divisors);
+    known.insert(known.end(), poly.a_factors.begin(), poly.a_factors.end());
+    sort(known.begin(), known.end());
+
+    mpz_class temp = abs(Q);
+    for (unsigned int k : known)
+    {
+        unsigned long p = factor_base.primes[k];
+        unsigned int count = 0;
+        while (mpz_divisible_ui_p(temp.get_mpz_t(), p))
+        {
+            mpz_divexact_ui(temp.get_mpz_t(), temp.get_mpz_t(), p);
+            count++;
+        }
+        trial_divisions += count + 1;
+        if (count > 0)
+            rel.factors.push_back(make_pair(static_cast<unsigned int>(k + 1), count));
+    }
+
+    if (!split_cofactor(temp, large_bound, double_bound, large_prime1, large_prime2))
+        return false;
+
+    if (large_prime1 != 1)
+        rel.large_primes.push_back(large_prime1);
+    if (large_prime2 != 1)
+        rel.large_primes.push_back(large_prime2);
+
+    // X and -X (mod N) give the same relation, keep one representative so duplicates can be spotted
+    rel.x = X % N;
+    if (rel.x < 0)
+        rel.x += N;
+    if (2 * rel.x > N)
+        rel.x = N - rel.x;
+    return true;
+}
+
+// Moves on to the next b, the next a is chosen at the top of the sieving loop once all b are done
+static void step_polynomial(const FactorBase &factor_base, SiqsState &state)
+{
+    state.polynomials++;
+    state.b_index++;
+    if (state.b_index < state.b_count)
+    {
+        next_polynomial_b(factor_base, state);
+    }
+}
+
+// How far below log2 |Q(x) / a| a sieve value may be and still be checked by trial division
+static double siqs_slack(const FactorBase &factor_base,
+                         double threshold_slack,
+                         unsigned long large_bound,
+                         unsigned long double_bound)
+{
+    // Allow some slack for prime powers and primes we don't sieve, and for the large primes of partial relations
+    double slack = threshold_slack * log2(factor_base.primes.back());
+    if (USE_LARGE_PRIMES)
+        slack += log2(static_cast<double>(max(large_bound, double_bound)) / factor_base.primes.back());
+
+    // The small primes are left out of the sieve, allow for what they contribute on average
+    size_t small_end = small_prime_end(factor_base.primes);
+    return slack + skipped_primes_log2(factor_base.primes, factor_base.root1, factor_base.root2, small_end);
+}
+
+// Byte value a sieve position of the block [block_start, block_start + len) must reach to be checked,
+// from the largest |Q(x) / a| = |(a*x + b)^2 - N| / a over the block
+static unsigned char block_threshold(const mpz_class &N,
+                                     const SiqsPolynomial &poly,
+                                     unsigned long M,
+                                     unsigned long block_start,
+                                     unsigned long len,
+                                     double slack)
+{
+    double a = poly.a.get_d();
+    double b = poly.b.get_d();
+    double n = N.get_d();
+
+    // The largest value is at an end of the block, the smallest at the vertex x = -b / a
+    double lo = static_cast<double>(block_start) - M;
+    double hi = lo + len - 1;
+    double largest = max(fabs((a * lo + b) * (a * lo + b) - n), fabs((a * hi + b) * (a * hi + b) - n));
+    if (-b / a > lo && -b / a < hi)
+        largest = max(largest, n);
+    return scaled_log2(exp2(log2(largest / a) - slack));
+}
+
+// Copies the current polynomial of the state into poly, reusing its buffers
+static void copy_polynomial(const SiqsState &state, SiqsPolynomial &poly)
+{
+    poly.a = state.a;
+    poly.b = state.b;
+    poly.a_factors = state.a_factors;
+    poly.sieve_logs = state.sieve_logs;
+    poly.start1 = state.soln1;
+    poly.start2 = state.soln2;
+}
+
+// Sieves the first count polynomials of batch over [-M, M) and checks the candidates, adding the full relations
+// found to relations and the partial relations (with their large primes) to partial_relations
+static void sieve_batch(const mpz_class &N,
+                        const FactorBase &factor_base,
+                        unsigned long M,
+                        vector<SiqsPolynomial> &batch,
+                        size_t count,
+                        double slack,
+                        unsigned long large_bound,
+                        unsigned long double_bound,
+                        vector<Relation> &relations,
+                        vector<Relation> &partial_relations,
+                        SieveStats &stats)
+{
+    size_t fb_size = factor_base.size();
+    unsigned long num_blocks = (2 * M + SIEVE_BLOCK_SIZE - 1) / SIEVE_BLOCK_SIZE;
+    size_t num_items = count * num_blocks;
+
+    // Primes larger than a block hit it at most a few times, so their hits are sorted into buckets up front,
+    // and the smallest primes are not sieved at all
+    size_t small_end = small_prime_end(factor_base.primes);
+    size_t bucket_start = bucket_sieve_start(factor_base.primes);
+
+    // Each thread sieves in its own cache-sized array, so no atomics are needed, and keeps the relations it finds
+    // to itself until the whole batch is done. Only the candidates reaching the threshold are checked with
+    // multiprecision arithmetic
+#pragma omp parallel
+    {
+        vector<unsigned char> block;
+        vector<unsigned long> candidates;
+        vector<vector<unsigned int>> divisors;
+        vector<unsigned int> slots;
+        vector<Relation> local_relations;
+        vector<Relation> local_partials;
+        SieveStats local_stats;
+
+        // Roots (copied from the state as x mod p) become sieve positions, and the buckets are filled
+#pragma omp for schedule(dynamic)
+        for (size_t k = 0; k < count; k++)
+        {
+            SiqsPolynomial &poly = batch[k];
+            for (size_t i = 0; i < fb_size; i++)
+            {
+                unsigned long p = factor_base.primes[i];
+                poly.start1[i] = (poly.start1[i] + M) % p;
+                poly.start2[i] = (poly.start2[i] + M) % p;
+            }
+            fill_buckets(0, 2 * M, bucket_start, factor_base.primes, poly.sieve_logs, poly.start1, poly.start2,
+                         poly.buckets);
+        }
+
+        // Every (polynomial, block) pair is a work item, handed to whichever thread is free next. With several
+        // polynomials in the batch there are enough items to keep every thread busy even though one polynomial
+        // only spans a few blocks
+#pragma omp for schedule(dynamic)
+        for (size_t item = 0; item < num_items; item++)
+        {
+            const SiqsPolynomial &poly = batch[item / num_blocks];
+            unsigned long blk = item % num_blocks;
+            unsigned long block_start = blk * SIEVE_BLOCK_SIZE;
+            block.resize(min(static_cast<unsigned long>(SIEVE_BLOCK_SIZE), 2 * M - block_start));
+
+            chrono::steady_clock::time_point step_start = chrono::steady_clock::now();
+            sieve_block(block, block_start, factor_base.primes, poly.sieve_logs, poly.start1, poly.start2, small_end,
+                        bucket_start, poly.buckets[blk]);
+            local_stats.sieve_seconds += lap_seconds(step_start);
+
+            unsigned char threshold = block_threshold(N, poly, M, block_start, block.size(), slack);
+            candidates.clear();
+            scan_block(block, block_start, threshold, candidates);
+            size_t num_candidates = candidates.size();
+            local_stats.positions += block.size();
+            local_stats.candidates += num_candidates;
+
+            // Positions sampled below the threshold are checked after the candidates
+            if (SIEVE_THRESHOLD_STATS)
+            {
+                sample_block(block, block_start, threshold, candidates);
+                local_stats.sampled += candidates.size() - num_candidates;
+            }
+            local_stats.scan_seconds += lap_seconds(step_start);
+
+            resieve_block(block.size(), block_start, factor_base.primes, poly.sieve_logs, poly.start1, poly.start2,
+                          bucket_start, poly.buckets[blk], candidates, divisors, slots);
+            local_stats.resieve_seconds += lap_seconds(step_start);
+
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                Relation rel;
+                long x = static_cast<long>(candidates[c]) - static_cast<long>(M);
+                unsigned long large_prime1, large_prime2;
+                if (!siqs_relation(N, factor_base, poly, x, divisors[c], large_bound, double_bound, rel,
+                                   large_prime1, large_prime2, local_stats.trial_divisions))
+                {
+                    if (c < num_candidates)
+                        local_stats.rejected++;
+                    continue;
+                }
+                bool full = large_prime1 == 1 && large_prime2 == 1;
+                if (c >= num_candidates)
+                    local_stats.missed++;
+                else if (full)
+                    local_stats.smooth++;
+                else
+                    local_stats.partial++;
+
+                if (full)
+                    local_relations.push_back(rel);
+                else
+                    local_partials.push_back(rel);
+            }
+            local_stats.trial_seconds += lap_seconds(step_start);
+        }
+
+#pragma omp critical
+        {
+            stats.add(local_stats);
+            relations.insert(relations.end(), local_relations.begin(), local_relations.end());
+            partial_relations.insert(partial_relations.end(), local_partials.begin(), local_partials.end());
+        }
+    }
+}
+
+// Polynomials sieved together, enough for every thread to have SIQS_BATCH_POLYNOMIALS
+static size_t batch_size()
+{
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    return SIQS_BATCH_POLYNOMIALS * threads;
+}
+
+vector<Relation> find_smooth_relations_siqs(const mpz_class &N,
+                                            const FactorBase &factor_base,
+                                            unsigned long sieve_interval,
+                                            vector<Relation> &existing_relations,
+                                            SiqsState &state,
+                                            PartialRelations &partials)
+{
+    size_t fb_size = factor_base.size();
+    unsigned long M = sieve_interval / 2;
+
+    vector<Relation> relations = existing_relations; // Start with existing relations
+
+    // Collect a few more relations than primes so there are several dependencies to try
+    size_t target = max(fb_size + state.extra_relations, existing_relations.size() + state.extra_relations);
+
+    unsigned long large_bound = large_prime_bound(factor_base);
+    unsigned long double_bound = double_large_prime_bound(factor_base, N);
+    double slack = siqs_slack(factor_base, state.threshold_slack, large_bound, double_bound);
+
+    vector<SiqsPolynomial> batch(batch_size());
+    vector<Relation> partial_relations;
+    bool exhausted = false;
+    while (relations.size() < target && !exhausted && !(state.cancel && *state.cancel))
+    {
+        // Copy out the next polynomials, stepping the state on as they are taken
+        unsigned long first_polynomial = state.polynomials;
+        size_t count = 0;
+        while (count < batch.size())
+        {
+            if (state.b_index >= state.b_count && !new_polynomial_a(N, factor_base, M, state))
+            {
+                cerr << "SIQS: could not find a new polynomial coefficient a." << endl;
+                exhausted = true;
+                break;
+            }
+
+            // Polynomials sieved before a restart are generated again (the choice of a is seeded) but not sieved
+            if (state.polynomials >= state.resume_polynomials)
+                copy_polynomial(state, batch[count++]);
+            step_polynomial(factor_base, state);
+        }
+
+        partial_relations.clear();
+        sieve_batch(N, factor_base, M, batch, count, slack, large_bound, double_bound, relations, partial_relations,
+                    state.stats);
+
+        // Add the partials to the large prime graph, where cycles give full relations
+        for (const Relation &rel : partial_relations)
+        {
+            Relation full;
+            if (add_partial_relation(partials, rel, N, full))
+                relations.push_back(full);
+        }
+
+        // Checkpoints and progress reports are due whenever the batch crosses a multiple of their period
+        if (state.log && state.polynomials / CHECKPOINT_POLYNOMIALS != first_polynomial / CHECKPOINT_POLYNOMIALS)
+        {
+            state.log->progress.use_siqs = true;
+            state.log->progress.polynomials = state.polynomials;
+            write_checkpoint(*state.log, relations, partials);
+        }
+
+        bool report = state.polynomials / 100 != first_polynomial / 100;
+        if (report && state.on_progress)
+            state.on_progress(state.polynomials, relations.size(), target);
+
+        if (report && verbose())
+        {
+            cout << "SIQS: " << state.polynomials << " polynomials sieved, "
+                 << relations.size() << " of " << target << " relations ("
+                 << partials.combined_count << " from " << partials.partial_count << " partials, "
+                 << partials.double_count << " with two large primes)." << endl;
+        }
+    }
+
+    return relations;
+}
+
+void sieve_siqs_unit(const mpz_class &N,
+                     const FactorBase &factor_base,
+                     unsigned long sieve_interval,
+                     uint64_t seed,
+                     double threshold_slack,
+                     unsigned long unit,
+                     vector<Relation> &relations,
+                     vector<Relation> &partial_relations)
+{
+    unsigned long M = sieve_interval / 2;
+    unsigned long large_bound = large_prime_bound(factor_base);
+    unsigned long double_bound = double_large_prime_bound(factor_base, N);
+    double slack = siqs_slack(factor_base, threshold_slack, large_bound, double_bound);
+
+    SiqsState state(seed + unit);
+    if (!new_polynomial_a(N, factor_base, M, state))
+        return;
+
+    // The b values of the unit are sieved a batch at a time
+    vector<SiqsPolynomial> batch(batch_size());
+    while (state.b_index < state.b_count)
+    {
+        size_t count = 0;
+        while (count < batch.size() && state.b_index < state.b_count)
+        {
+            copy_polynomial(state, batch[count++]);
+            step_polynomial(factor_base, state);
+        }
+        sieve_batch(N, factor_base, M, batch, count, slack, large_bound, double_bound, relations, partial_relations,
+                    state.stats);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SIQS_H
+#define SIQS_H
+
+#include <gmpxx.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <set>
+#include <vector>
+#include "config.h"
+#include "smooth_relations.h"
+#include "large_prime.h"
+#include "checkpoint.h"
+#include "sieve.h"
+
+// Self-initializing quadratic sieve state, kept between calls so sieving
+// resumes at the next polynomial instead of starting over
+struct SiqsState
+{
+    std::vector<unsigned char> sieve_logs; // factor base logs, with 0 for the primes dividing a (not sieved)
+
+    // Current polynomial Q(x) = (a*x + b)^2 - N = a * (a*x^2 + 2*b*x + c)
+    mpz_class a;
+    mpz_class b;
+    std::vector<size_t> a_factors;                     // factor base indices of the primes q_l dividing a
+    std::vector<bool> divides_a;                       // true if the factor base prime divides a
+    std::vector<mpz_class> B_terms;                    // B_l^2 = N mod q_l and B_l = 0 mod q_j for j != l
+    std::vector<int> B_signs;                          // sign of each B_l in the current b
+    std::vector<unsigned long> soln1;                  // first root of the polynomial mod p
+    std::vector<unsigned long> soln2;                  // second root of the polynomial mod p
+    std::vector<std::vector<unsigned long>> Bainv2;    // 2 * B_l * a^-1 mod p, used for the Gray code switch
+    unsigned long b_index;                             // index of the next b for the current a
+    unsigned long b_count;                             // 2^(s-1) values of b per a
+
+    std::set<mpz_class> used_a; // never sieve the same a twice
+    std::mt19937_64 rng;        // random choice of the primes making up a
+    unsigned long polynomials;  // number of polynomials sieved so far
+
+    unsigned long resume_polynomials; // polynomials sieved before a restart, stepped over without sieving
+    RelationLog *log;                 // relation file for checkpoints, or NULL
+    const std::atomic<bool> *cancel;  // sieving stops between polynomials once set, or NULL
+    SieveStats stats;                 // candidates checked and rejected, for tuning the threshold
+    double threshold_slack;           // sieve threshold slack in multiples of log2 of the largest prime
+    size_t extra_relations;           // relations to collect beyond the size of the factor base
+
+    // Called every 100 polynomials with the polynomials sieved, relations collected and relations wanted
+    std::function<void(unsigned long, size_t, size_t)> on_progress;
+
+    SiqsState(uint64_t seed = SIQS_SEED)
+        : b_index(0), b_count(0), rng(seed), polynomials(0), resume_polynomials(0), log(NULL), cancel(NULL),
+          threshold_slack(SIEVE_THRESHOLD_SLACK), extra_relations(SIQS_EXTRA_RELATIONS) {}
+};
+
+// Find B-smooth relations by sieving many polynomials (a*x + b)^2 - N over [-M, M),
+// where M = sieve_interval / 2. Stops once there are enough relations to run the linear algebra
+std::vector<Relation> find_smooth_relations_siqs(
+    const mpz_class &N,
+    const FactorBase &factor_base,
+    unsigned long sieve_interval,
+    std::vector<Relation> &existing_relations,
+    SiqsState &state,
+    PartialRelations &partials);
+
+// Sieves all the polynomials of one coefficient a, chosen with the seed seed + unit, so that units can be
+// handed out to independent processes. threshold_slack is the SiqsState one of a local run. Partial relations are returned as they are rather than combined
+void sieve_siqs_unit(const mpz_class &N,
+                     const FactorBase &factor_base,
+                     unsigned long sieve_interval,
+                     uint64_t seed,
+                     double threshold_slack,
+                     unsigned long unit,
+                     std::vector<Relation> &relations,
+                     std::vector<Relation> &partial_relations);
+
+#endif // SIQS_H
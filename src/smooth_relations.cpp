@@ -1,5 +1,12 @@
 #include "smooth_relations.h"
+#include "sieve.h"
+#include "scan.h"
+#include "large_prime.h"
+#include "config.h"
 #include <omp.h>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
 
 using namespace std;
 
@@ -12,6 +19,54 @@ mpz_class isqrt(const mpz_class &n)
     return root;
 }
 
+vector<unsigned int> odd_columns(const Relation &rel)
+{
+    vector<unsigned int> columns;
+    for (const pair<unsigned int, unsigned int> &f : rel.factors)
+    {
+        if (f.second & 1)
+            columns.push_back(f.first);
+    }
+    return columns;
+}
+
+size_t relation_columns(const vector<Relation> &relations)
+{
+    size_t columns = 0;
+    for (const Relation &rel : relations)
+    {
+        if (!rel.factors.empty())
+            columns = max(columns, static_cast<size_t>(rel.factors.back().first) + 1);
+    }
+    return columns;
+}
+
+void multiply_relation(Relation &rel, const Relation &other, const mpz_class &N)
+{
+    rel.x = (rel.x * other.x) % N;
+
+    // Merge the two sorted factor lists, adding exponents of shared columns
+    vector<pair<unsigned int, unsigned int>> factors;
+    factors.reserve(rel.factors.size() + other.factors.size());
+    size_t i = 0, j = 0;
+    while (i < rel.factors.size() || j < other.factors.size())
+    {
+        if (j == other.factors.size() || (i < rel.factors.size() && rel.factors[i].first < other.factors[j].first))
+            factors.push_back(rel.factors[i++]);
+        else if (i == rel.factors.size() || other.factors[j].first < rel.factors[i].first)
+            factors.push_back(other.factors[j++]);
+        else
+        {
+            factors.push_back(make_pair(rel.factors[i].first, rel.factors[i].second + other.factors[j].second));
+            i++;
+            j++;
+        }
+    }
+    rel.factors.swap(factors);
+
+    rel.large_primes.insert(rel.large_primes.end(), other.large_primes.begin(), other.large_primes.end());
+}
+
 // Fast modular exponentiation for unsigned long integers
 // just uses bitwise shifing and squaring
 unsigned long mod_exp(unsigned long base, unsigned long exp, unsigned long mod)
@@ -31,17 +86,16 @@ unsigned long mod_exp(unsigned long base, unsigned long exp, unsigned long mod)
 // Tonelli-Shanks algorithm for finding square roots modulo p
 // outputs the square roots x where x^2 = a mod p
 // as seen in https://en.wikipedia.org/wiki/Tonelli%E2%80%93Shanks_algorithm
-vector<unsigned long> tonelli_shanks(const mpz_class &a_mpz, unsigned long p)
+vector<unsigned long> tonelli_shanks(unsigned long a, unsigned long p)
 {
     vector<unsigned long> sol;
     if (p == 2)
     {
-        sol.push_back(a_mpz.get_ui() % 2);
+        sol.push_back(a % 2);
         return sol;
     }
 
-    // Work with unsigned long: a = a mod p.
-    unsigned long a = mpz_class(a_mpz % p).get_ui();
+    a %= p;
 
     // Check if a is a quadratic residue mod p. 
     // requirement for the algorithm
@@ -106,191 +160,225 @@ vector<unsigned long> tonelli_shanks(const mpz_class &a_mpz, unsigned long p)
     return sol;
 }
 
+// Byte value position i of the interval must reach, the smallest one not below log2 Q(i) - slack,
+// with Q(i) = q0 + i * (two_x0 + i)
+static unsigned char position_threshold(double q0, double two_x0, double slack, double i)
+{
+    double q = q0 + i * (two_x0 + i);
+    if (q < 1)
+        return 0;
+    return static_cast<unsigned char>(max(0.0, min(255.0, ceil(log2(q) - slack))));
+}
+
+// Position from which log2 Q(i) - slack is above threshold: the root of i^2 + two_x0 * i + q0 = 2^(threshold + slack),
+// written so that it doesn't cancel when two_x0 is large
+static double threshold_end(double q0, double two_x0, double slack, unsigned char threshold)
+{
+    double d = exp2(threshold + slack) - q0;
+    if (d <= 0)
+        return 0;
+    return 2 * d / (two_x0 + sqrt(two_x0 * two_x0 + 4 * d));
+}
+
 // finds B-smooth values over a given interval
 vector<Relation> find_smooth_relations(const mpz_class &N,
-                                       const vector<unsigned long> &factor_base,
+                                       FactorBase &factor_base,
                                        unsigned long sieve_interval,
                                        vector<Relation> &existing_relations,
-                                       mpz_class &start_x)
+                                       mpz_class &start_x,
+                                       PartialRelations &partials,
+                                       double threshold_slack,
+                                       SieveStats &stats)
 {
-    // Use logarithmic sieving
-    vector<double> log_factor_base(factor_base.size());
+    const vector<unsigned long> &primes = factor_base.primes;
 
-#pragma omp parallel for // parallelize the initialization of log_factor_base
-    for (size_t i = 0; i < factor_base.size(); i++)
-    {
-        log_factor_base[i] = log(factor_base[i]);
-    }
+    // Q(start_x + i) = Q(start_x) + i * (2 * start_x + i), which is accurate enough in doubles for the threshold
+    mpz_class Q0 = start_x * start_x - N;
+    double q0 = Q0.get_d();
+    double two_x0 = mpz_class(2 * start_x).get_d();
+    double slack = threshold_slack * log2(primes.back());
 
-    vector<double> sieve_array(sieve_interval, 0.0); 
+    // Leave room for the large primes of partial relations
+    unsigned long large_bound = large_prime_bound(factor_base);
+    unsigned long double_bound = double_large_prime_bound(factor_base, N);
+    if (USE_LARGE_PRIMES)
+        slack += log2(static_cast<double>(max(large_bound, double_bound)) / primes.back());
 
-// Initialize sieve_array with logarithmic values of x^2 - N
-#pragma omp parallel for // parallelize the initialization of sieve_array
-    for (unsigned long i = 0; i < sieve_interval; i++)
-    {
-        mpz_class x = start_x + i;
-        mpz_class Q;
+    // The smallest primes are not sieved, allow for what they contribute on average
+    size_t small_end = small_prime_end(primes);
+    slack += skipped_primes_log2(primes, factor_base.root1, factor_base.root2, small_end);
 
-        // x^2 - N
-        mpz_mul(Q.get_mpz_t(), x.get_mpz_t(), x.get_mpz_t());
-        Q -= N;
+    unsigned long num_blocks = (sieve_interval + SIEVE_BLOCK_SIZE - 1) / SIEVE_BLOCK_SIZE;
 
-        // Store the logarithm of the absolute value
-        sieve_array[i] = log(abs(Q.get_d()));
-    }
+    // The hits of the primes larger than a block are sorted into per-block buckets BUCKET_CHUNK_BLOCKS blocks
+    // at a time, so the memory used doesn't grow with the sieve interval
+    size_t bucket_start = bucket_sieve_start(primes);
+    vector<vector<BucketHit>> buckets;
+    ScanKernel scan_kernel = best_scan_kernel();
 
-    // Store original values for precise checking later
-    vector<mpz_class> q_values(sieve_interval);
+    // Process the candidates to find actual B-smooth relations
+    vector<Relation> relations = existing_relations; // Start with existing relations
 
-#pragma omp parallel for
-    for (unsigned long i = 0; i < sieve_interval; i++)
+// Each thread sieves whole blocks in its own cache-sized array, so no atomics are needed,
+// and only positions reaching the threshold are checked with multiprecision arithmetic
+#pragma omp parallel
     {
-        mpz_class x = start_x + i;
-        mpz_class Q;
-
-        // x^2 - N
-        mpz_mul(Q.get_mpz_t(), x.get_mpz_t(), x.get_mpz_t());
-        Q -= N;
+        vector<unsigned char> block;
+        vector<unsigned long> candidates;
+        vector<vector<unsigned int>> divisors;
+        vector<unsigned int> slots;
+        vector<Relation> local_relations;
+        vector<Relation> local_partials;
+        vector<pair<unsigned long, unsigned char>> steps;
+        SieveStats local_stats;
 
-        q_values[i] = Q;
-    }
+        for (unsigned long chunk = 0; chunk < num_blocks; chunk += BUCKET_CHUNK_BLOCKS)
+        {
+            unsigned long chunk_end = min(num_blocks, chunk + BUCKET_CHUNK_BLOCKS);
 
-// For each prime p in the factor base, subtract log(p) at appropriate positions
-#pragma omp parallel for schedule(dynamic)
-    for (size_t idx = 0; idx < factor_base.size(); idx++)
-    {
-        unsigned long p = factor_base[idx];
-        double log_p = log_factor_base[idx];
+            // The loop below ends with a barrier, so the buckets are refilled once every thread is done with them
+#pragma omp single
+            fill_buckets(chunk * SIEVE_BLOCK_SIZE, min(sieve_interval, chunk_end * SIEVE_BLOCK_SIZE), bucket_start,
+                         primes, factor_base.logs, factor_base.offset1, factor_base.offset2, buckets);
 
-        // handling p = 2 specially
-        if (p == 2)
-        {
-            for (unsigned long i = 0; i < sieve_interval; i++)
+#pragma omp for schedule(dynamic)
+            for (unsigned long blk = chunk; blk < chunk_end; blk++)
             {
-                if (mpz_divisible_ui_p(q_values[i].get_mpz_t(), 2))
+                unsigned long block_start = blk * SIEVE_BLOCK_SIZE;
+                block.resize(min(static_cast<unsigned long>(SIEVE_BLOCK_SIZE), sieve_interval - block_start));
+                const vector<BucketHit> &bucket = buckets[blk - chunk];
+
+                chrono::steady_clock::time_point step_start = chrono::steady_clock::now();
+                sieve_block(block, block_start, primes, factor_base.logs, factor_base.offset1, factor_base.offset2,
+                            small_end, bucket_start, bucket);
+                local_stats.sieve_seconds += lap_seconds(step_start);
+
+                // Q(x) grows over the whole interval (start_x is at least sqrt(N)), so the threshold only steps up,
+                // once each time Q doubles. It is worked out at those steps, as (end of the step, threshold) pairs
+                steps.clear();
+                for (unsigned long j = 0; j < block.size();)
                 {
-                    // For each power of 2 that divides q_values[i], subtract log(2)
-                    mpz_class temp = q_values[i];
-                    while (mpz_divisible_ui_p(temp.get_mpz_t(), 2))
-                    {
-#pragma omp atomic
-                        sieve_array[i] -= log_p;
-                        mpz_divexact_ui(temp.get_mpz_t(), temp.get_mpz_t(), 2);
-                    }
+                    double i = static_cast<double>(block_start + j);
+                    unsigned char threshold = position_threshold(q0, two_x0, slack, i);
+                    double end = threshold_end(q0, two_x0, slack, threshold) - block_start;
+                    unsigned long step_end = block.size();
+                    if (end < block.size())
+                        step_end = max(j + 1, static_cast<unsigned long>(max(0.0, floor(end))) + 1);
+                    steps.push_back(make_pair(step_end, threshold));
+                    j = step_end;
                 }
-            }
-            continue;
-        }
 
-        // using tonelli shanks to find solutions quickly
-        vector<unsigned long> sols = tonelli_shanks(N, p);
-        if (sols.empty())
-            continue;
-
-        for (unsigned long r : sols)
-        {
-            unsigned long start_x_mod = mpz_class(start_x % p).get_ui();
-            unsigned long offset = (r >= start_x_mod) ? (r - start_x_mod) : (p - (start_x_mod - r));
-
-            // Subtract log(p) for each position divisible by p
-            for (unsigned long i = offset; i < sieve_interval; i += p)
-            {
-                mpz_class temp = q_values[i];
-                while (mpz_divisible_ui_p(temp.get_mpz_t(), p))
+                candidates.clear();
+                unsigned long j = 0;
+                for (const pair<unsigned long, unsigned char> &step : steps)
                 {
-#pragma omp atomic
-                    sieve_array[i] -= log_p;
-                    mpz_divexact_ui(temp.get_mpz_t(), temp.get_mpz_t(), p);
+                    scan_bytes(scan_kernel, &block[j], step.first - j, step.second, block_start + j, candidates);
+                    j = step.first;
                 }
-            }
-        }
-    }
-
-    // Identify potentially smooth candidates
-    vector<unsigned long> candidates;
-    for (unsigned long i = 0; i < sieve_interval; i++)
-    {
-        if (sieve_array[i] < 0.1)
-        { // include floating point errors
-            candidates.push_back(i);
-        }
-    }
+                size_t num_candidates = candidates.size();
+                local_stats.positions += block.size();
+                local_stats.candidates += num_candidates;
 
-    // Process the candidates to find actual B-smooth relations
-    vector<Relation> relations = existing_relations; // Start with existing relations
-
-// Use parallel processing for checking candidates
-#pragma omp parallel
-    {
-        vector<Relation> local_relations;
-
-#pragma omp for schedule(dynamic)
-        for (size_t candidate_idx = 0; candidate_idx < candidates.size(); candidate_idx++)
-        {
-            unsigned long i = candidates[candidate_idx];
-
-// Skip if we already have enough relations
-#pragma omp critical
-            {
-                if (relations.size() >= factor_base.size() + 1)
-                    continue;
-            }
+                // Positions sampled below the threshold are checked after the candidates
+                if (SIEVE_THRESHOLD_STATS)
+                {
+                    unsigned long first = (SIEVE_STATS_SAMPLE - block_start % SIEVE_STATS_SAMPLE) % SIEVE_STATS_SAMPLE;
+                    size_t step = 0;
+                    for (unsigned long j = first; j < block.size(); j += SIEVE_STATS_SAMPLE)
+                    {
+                        while (steps[step].first <= j)
+                            step++;
+                        if (block[j] < steps[step].second)
+                            candidates.push_back(block_start + j);
+                    }
+                    local_stats.sampled += candidates.size() - num_candidates;
+                }
+                local_stats.scan_seconds += lap_seconds(step_start);
 
-            // Verify smoothness by trial division
-            mpz_class temp = q_values[i];
+                // Walk the roots again to find which primes divide each candidate
+                resieve_block(block.size(), block_start, primes, factor_base.logs, factor_base.offset1,
+                              factor_base.offset2, bucket_start, bucket, candidates, divisors, slots);
+                local_stats.resieve_seconds += lap_seconds(step_start);
 
-            for (unsigned long p : factor_base)
-            {
-                while (mpz_divisible_ui_p(temp.get_mpz_t(), p))
+                for (size_t c = 0; c < candidates.size(); c++)
                 {
-                    mpz_divexact_ui(temp.get_mpz_t(), temp.get_mpz_t(), p);
-                }
-            }
+                    mpz_class x = start_x + candidates[c];
+                    mpz_class Q = x * x - N;
 
-            // If temp is 1 or -1, we have a B-smooth number
-            if (temp == 1 || temp == -1)
-            {
-                Relation rel;
-                rel.x = start_x + i;
-                rel.Q = q_values[i];
+                    // Record the full exponents while verifying smoothness by trial division
+                    Relation rel;
+                    rel.x = x;
 
-                // Build the exponent vector mod 2
-                vector<int> vec;
+                    // For sign: if Q(x) is negative, record a 1 for -1
+                    if (Q < 0)
+                        rel.factors.push_back(make_pair(0u, 1u));
 
-                // For sign: if Q(x) is negative, record a 1 for -1
-                vec.push_back(q_values[i] < 0 ? 1 : 0);
+                    // Work with the absolute value
+                    mpz_class temp = abs(Q);
 
-                // Work with the absolute value
-                temp = q_values[i];
-                if (temp < 0)
-                    temp = -temp;
+                    // Count the exponent of each prime found by resieving
+                    for (unsigned int k : divisors[c])
+                    {
+                        unsigned int count = 0;
+                        while (mpz_divisible_ui_p(temp.get_mpz_t(), primes[k]))
+                        {
+                            mpz_divexact_ui(temp.get_mpz_t(), temp.get_mpz_t(), primes[k]);
+                            count++;
+                        }
+                        local_stats.trial_divisions += count + 1;
+                        if (count > 0)
+                            rel.factors.push_back(make_pair(k + 1, count));
+                    }
 
-                // For each prime in factor_base, count the exponent (mod 2) by trial division
-                for (unsigned long p : factor_base)
-                {
-                    int count = 0;
-                    while (mpz_divisible_ui_p(temp.get_mpz_t(), p))
+                    // If temp is 1, we have a B-smooth number, otherwise it may be a partial relation with large primes
+                    unsigned long large_prime1, large_prime2;
+                    if (split_cofactor(temp, large_bound, double_bound, large_prime1, large_prime2))
                     {
-                        mpz_divexact_ui(temp.get_mpz_t(), temp.get_mpz_t(), p);
-                        count++;
+                        if (large_prime1 != 1)
+                            rel.large_primes.push_back(large_prime1);
+                        if (large_prime2 != 1)
+                            rel.large_primes.push_back(large_prime2);
+                        bool full = large_prime1 == 1 && large_prime2 == 1;
+                        if (full)
+                            local_relations.push_back(rel);
+                        else
+                            local_partials.push_back(rel);
+                        if (c >= num_candidates)
+                            local_stats.missed++;
+                        else if (full)
+                            local_stats.smooth++;
+                        else
+                            local_stats.partial++;
+                    }
+                    else if (c < num_candidates)
+                    {
+                        local_stats.rejected++;
                     }
-                    vec.push_back(count % 2); // add the exponent mod 2
                 }
-
-                rel.exponents = vec;
-                local_relations.push_back(rel);
+                local_stats.trial_seconds += lap_seconds(step_start);
             }
         }
 
-// Merge current relations into the global relations vector
+// Merge current relations into the global relations vector, keeping all of them so every interval adds rows
+// to the echelon form, and add the partials to the large prime graph where cycles give full relations
 #pragma omp critical
         {
+            stats.add(local_stats);
             relations.insert(relations.end(), local_relations.begin(), local_relations.end());
+            for (size_t k = 0; k < local_partials.size(); k++)
+            {
+                Relation full;
+                if (add_partial_relation(partials, local_partials[k], N, full))
+                {
+                    relations.push_back(full);
+                }
+            }
         }
     }
 
-    // Update the start_x for the next iteration
+    // Update the start_x and the sieve offsets for the next iteration
     start_x = start_x + sieve_interval;
+    advanceSieveOffsets(factor_base, sieve_interval);
 
     return relations;
-}
\ No newline at end of file
+}
@@ -3,21 +3,43 @@
 
 #include <gmpxx.h>
 #include <map>
+#include <vector>
+#include "factors.h"
+#include "sieve.h"
 
+// x^2 = Q (mod N), with Q kept in factored form: the sign, the factor base primes and any large primes
 struct Relation
 {
     mpz_class x;
-    mpz_class Q;                // Q(x) = x^2 - N
-    std::vector<int> exponents; // Exponent vector (mod 2)
+    std::vector<std::pair<unsigned int, unsigned int>> factors; // (column, exponent) sorted by column, where column 0 is
+                                                                // the sign of Q and column i + 1 the i-th factor base prime
+    std::vector<unsigned long> large_primes;                    // primes above the factor base dividing Q (with repetition)
 };
 
+// Columns with an odd exponent, i.e. the relation's exponent vector mod 2
+std::vector<unsigned int> odd_columns(const Relation &rel);
+
+// Number of columns needed for the exponent vectors of the relations
+size_t relation_columns(const std::vector<Relation> &relations);
+
+// Multiplies other into rel: x values multiply mod N and exponents add
+void multiply_relation(Relation &rel, const Relation &other, const mpz_class &N);
+
+struct PartialRelations;
+
 // Function to find B-smooth relations
 std::vector<Relation> find_smooth_relations(
     const mpz_class &N,
-    const std::vector<unsigned long> &factor_base,
+    FactorBase &factor_base,
     unsigned long sieve_interval,
     std::vector<Relation> &existing_relations,
-    mpz_class &start_x);
+    mpz_class &start_x,
+    PartialRelations &partials,
+    double threshold_slack,
+    SieveStats &stats);
+
+// Square roots of a modulo the prime p (empty if a is not a quadratic residue)
+std::vector<unsigned long> tonelli_shanks(unsigned long a, unsigned long p);
 
 // Compute ceil(sqrt(n))
 mpz_class isqrt(const mpz_class &n);
@@ -1,15 +1,23 @@
 #include "smoothness_bound.h"
 #include "config.h"
+#include <cmath>
 
-unsigned long smoothnessBound(const mpz_class &n)
+unsigned long smoothnessBound(const mpz_class &n, bool use_siqs)
 {
 
     // We can convert mpz_class to double, which is fine as we only need a rough estimate of the log
     double ln_n = log(n.get_d());
     double ln_ln_n = log(ln_n);
 
+    // SIQS keeps Q(x) much smaller, so it works best with a smaller bound
+    double constant = B_CONSTANT;
+    if (use_siqs)
+    {
+        constant = SIQS_B_CONSTANT;
+    }
+
     // Calculate the smoothness bound B using chosen formula
-    double B_double = exp((0.5 + B_CONSTANT) * sqrt(ln_n * ln_ln_n));
+    double B_double = exp((0.5 + constant) * sqrt(ln_n * ln_ln_n));
     unsigned long B = static_cast<unsigned long>(B_double);
 
     if (B < 2)
@@ -3,7 +3,7 @@
 
 #include <gmpxx.h>
 
-// Smoothness bound for the given composite number n
-unsigned long smoothnessBound(const mpz_class &n);
+// Smoothness bound for the given composite number n, smaller when it will be sieved with SIQS
+unsigned long smoothnessBound(const mpz_class &n, bool use_siqs);
 
 #endif // SMOOTHNESS_BOUND_H
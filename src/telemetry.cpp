@@ -0,0 +1,118 @@
+#include "telemetry.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+string telemetry_json(const Telemetry &t)
+{
+    ostringstream out;
+    out << "{\"n\": \"" << t.n << "\", \"digits\": " << t.digits << ", \"threads\": " << t.threads
+        << ", \"phase\": \"" << t.phase << "\", \"elapsed\": " << t.elapsed;
+
+    out << ", \"phases\": {\"factor_base\": " << t.times.factor_base << ", \"sieving\": " << t.times.sieving
+        << ", \"linear_algebra\": " << t.times.linear_algebra << ", \"square_root\": " << t.times.square_root << "}";
+
+    out << ", \"sieve\": {\"positions\": " << t.sieve.positions << ", \"candidates\": " << t.sieve.candidates
+        << ", \"smooth\": " << t.sieve.smooth << ", \"partial\": " << t.sieve.partial
+        << ", \"rejected\": " << t.sieve.rejected << ", \"trial_divisions\": " << t.sieve.trial_divisions
+        << ", \"sieve_seconds\": " << t.sieve.sieve_seconds << ", \"scan_seconds\": " << t.sieve.scan_seconds
+        << ", \"resieve_seconds\": " << t.sieve.resieve_seconds << ", \"trial_seconds\": " << t.sieve.trial_seconds
+        << "}";
+
+    out << ", \"relations\": {\"full\": " << t.times.relations << ", \"needed\": " << t.relations_needed
+        << ", \"partial\": " << t.partial_relations << ", \"combined\": " << t.combined_relations
+        << ", \"polynomials\": " << t.times.polynomials << "}";
+
+    out << ", \"linear_algebra\": {\"attempts\": " << t.attempts << ", \"dependencies\": " << t.dependencies
+        << ", \"filter_seconds\": " << t.filter_seconds << ", \"lanczos_seconds\": " << t.lanczos_seconds
+        << ", \"echelon_seconds\": " << t.echelon_seconds << "}}\n";
+    return out.str();
+}
+
+// HELP and TYPE lines of a metric family
+static void family(ostream &out, const char *name, const char *type, const char *help)
+{
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+// One sample, with the digits label and an optional second label
+static void sample(ostream &out, const char *name, const Telemetry &t, double value, const char *label = NULL,
+                   const char *label_value = NULL)
+{
+    out << name << "{digits=\"" << t.digits << "\"";
+    if (label)
+        out << "," << label << "=\"" << label_value << "\"";
+    out << "} " << value << "\n";
+}
+
+static void metric(ostream &out, const char *name, const char *type, const char *help, const Telemetry &t,
+                   double value)
+{
+    family(out, name, type, help);
+    sample(out, name, t, value);
+}
+
+string telemetry_prometheus(const Telemetry &t)
+{
+    ostringstream out;
+    out.precision(12);
+
+    metric(out, "qs_elapsed_seconds", "gauge", "Seconds since the factorisation started.", t, t.elapsed);
+    metric(out, "qs_threads", "gauge", "Threads used by the parallel loops.", t, t.threads);
+    metric(out, "qs_done", "gauge", "1 once the factorisation has ended.", t, t.phase == "done" ? 1 : 0);
+
+    family(out, "qs_phase_seconds", "counter", "Wall time of each finished phase.");
+    sample(out, "qs_phase_seconds", t, t.times.factor_base, "phase", "factor_base");
+    sample(out, "qs_phase_seconds", t, t.times.sieving, "phase", "sieving");
+    sample(out, "qs_phase_seconds", t, t.times.linear_algebra, "phase", "linear_algebra");
+    sample(out, "qs_phase_seconds", t, t.times.square_root, "phase", "square_root");
+
+    metric(out, "qs_sieve_positions_total", "counter", "Sieve positions scanned.", t, t.sieve.positions);
+    metric(out, "qs_sieve_candidates_total", "counter", "Positions reaching the sieve threshold.", t,
+           t.sieve.candidates);
+    family(out, "qs_sieve_confirmed_total", "counter", "Candidates confirmed as relations.");
+    sample(out, "qs_sieve_confirmed_total", t, t.sieve.smooth, "kind", "smooth");
+    sample(out, "qs_sieve_confirmed_total", t, t.sieve.partial, "kind", "partial");
+    metric(out, "qs_sieve_rejected_total", "counter", "Candidates giving no relation.", t, t.sieve.rejected);
+    metric(out, "qs_trial_divisions_total", "counter", "Divisibility tests of candidates by factor base primes.", t,
+           t.sieve.trial_divisions);
+
+    family(out, "qs_sieve_step_seconds", "counter", "Thread seconds in each step of the block sieve.");
+    sample(out, "qs_sieve_step_seconds", t, t.sieve.sieve_seconds, "step", "sieve");
+    sample(out, "qs_sieve_step_seconds", t, t.sieve.scan_seconds, "step", "scan");
+    sample(out, "qs_sieve_step_seconds", t, t.sieve.resieve_seconds, "step", "resieve");
+    sample(out, "qs_sieve_step_seconds", t, t.sieve.trial_seconds, "step", "trial_division");
+
+    metric(out, "qs_polynomials_total", "counter", "SIQS polynomials sieved.", t, t.times.polynomials);
+    metric(out, "qs_relations", "gauge", "Full relations collected.", t, t.times.relations);
+    metric(out, "qs_relations_needed", "gauge", "Full relations wanted before the next linear algebra attempt.", t,
+           t.relations_needed);
+    metric(out, "qs_partial_relations", "gauge", "Partial relations kept.", t, t.partial_relations);
+    metric(out, "qs_combined_relations", "gauge", "Full relations made out of partial relations.", t,
+           t.combined_relations);
+
+    metric(out, "qs_linear_algebra_attempts_total", "counter", "Linear algebra attempts.", t, t.attempts);
+    metric(out, "qs_dependencies_total", "counter", "Dependencies found.", t, t.dependencies);
+    family(out, "qs_linear_algebra_step_seconds", "counter", "Wall time in each step of the linear algebra.");
+    sample(out, "qs_linear_algebra_step_seconds", t, t.filter_seconds, "step", "filter");
+    sample(out, "qs_linear_algebra_step_seconds", t, t.lanczos_seconds, "step", "lanczos");
+    sample(out, "qs_linear_algebra_step_seconds", t, t.echelon_seconds, "step", "echelon");
+    return out.str();
+}
+
+bool write_telemetry(const string &path, const Telemetry &t)
+{
+    bool prometheus = path.size() >= 5 && path.compare(path.size() - 5, 5, ".prom") == 0;
+    string temp = path + ".tmp";
+    {
+        ofstream out(temp.c_str());
+        if (!out)
+            return false;
+        out << (prometheus ? telemetry_prometheus(t) : telemetry_json(t));
+        if (!out)
+            return false;
+    }
+    return rename(temp.c_str(), path.c_str()) == 0;
+}
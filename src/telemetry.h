@@ -0,0 +1,44 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstddef>
+#include <string>
+#include "factorize.h"
+#include "sieve.h"
+
+// Counters and timings of one factorisation, exported while it runs and when it ends
+struct Telemetry
+{
+    std::string n;             // number being factored
+    size_t digits;             // its size in decimal digits
+    int threads;               // threads used by the parallel loops
+    std::string phase;         // "sieving", "linear algebra", "square root" or "done", written as each starts
+    double elapsed;            // seconds since the start of the call
+    PhaseTimes times;          // time of each phase, the current one is added when it ends
+    SieveStats sieve;          // sieve counters, summed over threads and over both sieves
+    size_t relations_needed;   // full relations wanted before the next linear algebra attempt
+    size_t partial_relations;  // partial relations kept
+    size_t combined_relations; // full relations made out of partial ones
+    unsigned long attempts;    // linear algebra attempts
+    size_t dependencies;       // dependencies found over all attempts
+    double filter_seconds;     // filtering before Block Lanczos
+    double lanczos_seconds;    // Block Lanczos
+    double echelon_seconds;    // Gaussian elimination of the new relations into the echelon form
+
+    Telemetry()
+        : digits(0), threads(1), phase("factor base"), elapsed(0), relations_needed(0), partial_relations(0),
+          combined_relations(0), attempts(0), dependencies(0), filter_seconds(0), lanczos_seconds(0),
+          echelon_seconds(0) {}
+};
+
+// A single JSON object
+std::string telemetry_json(const Telemetry &t);
+
+// Prometheus text exposition format, every metric labelled with the size of the number
+std::string telemetry_prometheus(const Telemetry &t);
+
+// Writes Prometheus text if path ends in .prom and JSON otherwise. The file is written next to path and renamed
+// over it, so a reader polling it never sees half of it
+bool write_telemetry(const std::string &path, const Telemetry &t);
+
+#endif // TELEMETRY_H
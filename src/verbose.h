@@ -0,0 +1,15 @@
+#ifndef VERBOSE_H
+#define VERBOSE_H
+
+#include "config.h"
+
+// Progress output can also be turned off at run time, per thread, so that factorisations running
+// side by side (batch mode) stay quiet while the default single run keeps its output
+extern thread_local bool verbose_output;
+
+inline bool verbose()
+{
+    return VERBOSE && verbose_output;
+}
+
+#endif // VERBOSE_H